@@ -0,0 +1,116 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_BENCH_H
+#define T3_WIDGET_BENCH_H
+
+/* Minimal benchmark harness shared by the benchmark programs.
+
+   Each benchmark is run repeatedly until at least the minimum run time has passed, and the
+   fastest run is reported. The results are written to stdout as one JSON object per line, such
+   that they can be collected and compared between revisions. Options:
+     -f <substring>  only run the benchmarks whose name contains <substring>
+     -t <seconds>    minimum time to spend on each benchmark (default 0.5)
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+struct bench_options_t {
+  const char *filter;
+  double min_time;
+};
+
+static inline bench_options_t &bench_options() {
+  static bench_options_t options = {nullptr, 0.5};
+  return options;
+}
+
+static inline void bench_init(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      bench_options().filter = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      bench_options().min_time = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [-f <substring>] [-t <seconds>]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/** Prevent the compiler from optimizing away the computation of @p value. */
+template <typename T>
+static inline void bench_use(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/** Report the result of a benchmark.
+
+    @param name The name of the benchmark.
+    @param ops The number of operations performed by a single run.
+    @param runs The number of runs.
+    @param best The time in seconds taken by the fastest run.
+*/
+static inline void bench_report(const std::string &name, size_t ops, long runs, double best) {
+  printf("{\"benchmark\": \"%s\", \"ops\": %zu, \"runs\": %ld, \"ns_per_op\": %.3f}\n",
+         name.c_str(), ops, runs, best * 1e9 / (ops == 0 ? 1 : ops));
+  fflush(stdout);
+}
+
+/** Run @p func repeatedly, and report the time per operation.
+
+    @param name The name of the benchmark.
+    @param ops The number of operations performed by a single call to @p func.
+    @param setup Function called before each call to @p func, to bring the state back to the
+        same starting point. It is not included in the reported time, but it does count towards
+        the minimum run time, such that an expensive setup does not make the benchmark run for
+        a long time.
+    @param func The function to time.
+*/
+template <typename S, typename F>
+static void bench_run(const std::string &name, size_t ops, S setup, F func) {
+  typedef std::chrono::steady_clock clock;
+  if (bench_options().filter != nullptr && name.find(bench_options().filter) == std::string::npos)
+    return;
+
+  double best = 0;
+  long runs = 0;
+  clock::time_point bench_start = clock::now();
+  do {
+    setup();
+    clock::time_point start = clock::now();
+    func();
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (runs == 0 || elapsed < best) best = elapsed;
+    ++runs;
+  } while (std::chrono::duration<double>(clock::now() - bench_start).count() <
+           bench_options().min_time);
+
+  bench_report(name, ops, runs, best);
+}
+
+/** Run @p func repeatedly, and report the time per operation.
+
+    @param name The name of the benchmark.
+    @param ops The number of operations performed by a single call to @p func.
+    @param func The function to time.
+*/
+template <typename F>
+static void bench_run(const std::string &name, size_t ops, F func) {
+  bench_run(name, ops, [] {}, func);
+}
+
+#endif
@@ -0,0 +1,363 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Benchmarks for the editing core: loading text into a text_buffer_t, editing and undo/redo,
+   rewrapping, searching, painting lines and converting blocks. All benchmarks run over four
+   generated corpora, which stress different parts of the code:
+     source  ASCII C++-like source code, with indentation and short lines
+     cjk     Chinese text, consisting of double width characters only
+     json    minified JSON, as a single line of several megabytes
+     log     a million lines of log messages
+   Rewrapping and painting need a terminal, so the library is initialized in headless mode. As
+   wrap_info_t is internal to the library, rewrapping is measured through edit_window_t, which
+   reports the time used by its last rewrap.
+
+   The per-operation times are: per byte for loading, converting, searching and rewrapping, per
+   character for editing, per undo record for undo/redo, and per line for painting. */
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <t3widget/findcontext.h>
+#include <t3widget/headless.h>
+#include <t3widget/main.h>
+#include <t3widget/textbuffer.h>
+#include <t3widget/widgets/editwindow.h>
+
+#include "bench.h"
+
+using namespace t3_widget;
+
+namespace {
+
+struct corpus_t {
+  const char *name;
+  std::string text;
+  /* Strings to search for. The first occurs often in the text, the second rarely. */
+  const char *common, *rare;
+  const char *regex;
+};
+
+void append_utf8(std::string *str, unsigned c) {
+  if (c < 0x80) {
+    *str += static_cast<char>(c);
+  } else if (c < 0x800) {
+    *str += static_cast<char>(0xc0 | (c >> 6));
+    *str += static_cast<char>(0x80 | (c & 0x3f));
+  } else {
+    *str += static_cast<char>(0xe0 | (c >> 12));
+    *str += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+    *str += static_cast<char>(0x80 | (c & 0x3f));
+  }
+}
+
+std::string generate_source(int lines) {
+  static const char *const identifiers[] = {"result", "size", "text", "line", "pos", "window",
+                                            "impl->lines", "cursor", "info", "width"};
+  static const char *const templates[] = {
+      "if (%s < %s) return false;",     "%s = %s + 1;",
+      "for (int i = 0; i < %s; i++) {", "}",
+      "// Update %s to match %s.",      "%s->set_size(%s, None);",
+      "return %s;",                     "std::string *%s = new std::string(%s);",
+  };
+  std::mt19937 rng(1);
+  std::string text;
+  char buffer[256];
+  int indent = 1;
+  for (int i = 0; i < lines; ++i) {
+    unsigned kind = rng() % 9;
+    if (kind == 8) {
+      text += '\n';
+      continue;
+    }
+    const char *first = identifiers[rng() % 10];
+    const char *second = identifiers[rng() % 10];
+    snprintf(buffer, sizeof(buffer), templates[kind], first, second);
+    text.append(indent * 2, ' ');
+    text += buffer;
+    text += '\n';
+    if (kind == 2 && indent < 6) {
+      ++indent;
+    } else if (kind == 3 && indent > 1) {
+      --indent;
+    }
+  }
+  return text;
+}
+
+std::string generate_cjk(int lines) {
+  std::mt19937 rng(2);
+  std::string text;
+  for (int i = 0; i < lines; ++i) {
+    int length = 20 + rng() % 60;
+    for (int j = 0; j < length; ++j) {
+      if (j % 17 == 16) {
+        // Ideographic comma.
+        append_utf8(&text, 0x3001);
+      } else {
+        // Restrict to the first 256 ideographs, such that the search strings occur.
+        append_utf8(&text, 0x4e00 + rng() % 256);
+      }
+    }
+    // Ideographic full stop.
+    append_utf8(&text, 0x3002);
+    text += '\n';
+  }
+  return text;
+}
+
+std::string generate_json(size_t size) {
+  std::mt19937 rng(3);
+  std::string text = "[";
+  char buffer[256];
+  for (int i = 0; text.size() < size; ++i) {
+    snprintf(buffer, sizeof(buffer),
+             "%s{\"id\":%d,\"name\":\"item%u\",\"tags\":[\"a\",\"b%u\"],\"value\":%u.%02u,"
+             "\"enabled\":%s}",
+             i == 0 ? "" : ",", i, static_cast<unsigned>(rng() % 100000),
+             static_cast<unsigned>(rng() % 10), static_cast<unsigned>(rng() % 1000),
+             static_cast<unsigned>(rng() % 100), rng() % 2 ? "true" : "false");
+    text += buffer;
+  }
+  text += "]";
+  return text;
+}
+
+std::string generate_log(int lines) {
+  static const char *const levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+  static const char *const messages[] = {
+      "connection accepted from 10.0.%u.%u", "request completed in %u ms with status 200",
+      "cache miss for key session:%u:%u",    "retrying upload of chunk %u after %u ms",
+      "disk usage at %u%% on volume %u",
+  };
+  std::mt19937 rng(4);
+  std::string text;
+  char message[128], buffer[256];
+  for (int i = 0; i < lines; ++i) {
+    snprintf(message, sizeof(message), messages[rng() % 5], static_cast<unsigned>(rng() % 256),
+             static_cast<unsigned>(rng() % 256));
+    snprintf(buffer, sizeof(buffer), "2018-03-%02d %02d:%02d:%02d.%03d [%s] worker-%u: %s\n",
+             1 + i / 86400 % 28, i / 3600 % 24, i / 60 % 60, i % 60, i % 1000,
+             levels[rng() % 6], static_cast<unsigned>(rng() % 16), message);
+    text += buffer;
+  }
+  return text;
+}
+
+std::unique_ptr<text_buffer_t> load(const std::string &text) {
+  std::unique_ptr<text_buffer_t> buffer(new text_buffer_t());
+  buffer->append_text(text.data(), text.size());
+  return buffer;
+}
+
+/* Find all matches in the text, starting at the top. The search starts at the cursor. */
+size_t find_all(text_buffer_t *text, finder_t *finder) {
+  find_result_t result;
+  size_t count = 0;
+  text->cursor = text_coordinate_t(0, 0);
+  while (text->find(finder, &result, false)) {
+    ++count;
+    text->cursor = result.end;
+  }
+  return count;
+}
+
+/* Positions at which to edit: the end of every eighth line, up to @p count positions. */
+std::vector<text_coordinate_t> edit_positions(const text_buffer_t *text, size_t count) {
+  std::vector<text_coordinate_t> positions;
+  for (int i = 0; i < text->size() && positions.size() < count; i += 8)
+    positions.push_back(text_coordinate_t(i, text->get_line_max(i)));
+  return positions;
+}
+
+void bench_editing(const corpus_t &corpus) {
+  std::string prefix = std::string("edit/") + corpus.name;
+  std::unique_ptr<text_buffer_t> text;
+  std::vector<text_coordinate_t> positions = edit_positions(load(corpus.text).get(), 256);
+  static const char word[] = "abcdefghijklmnop";
+  const size_t word_length = sizeof(word) - 1;
+  const size_t chars = positions.size() * word_length;
+  /* Each edit adds to the undo list, so every run starts from a freshly loaded text. Otherwise
+     later runs would work on an ever larger undo list. */
+  auto reload = [&] {
+    text.reset();
+    text = load(corpus.text);
+  };
+
+  /* Typing a word and deleting it again at each position leaves the text unchanged. Positions
+     are visited back to front, so the insertions do not shift the later positions. */
+  bench_run(prefix + "/insert_char+backspace_char", 2 * chars, reload, [&] {
+    for (size_t i = positions.size(); i-- > 0;) {
+      text->cursor = positions[i];
+      for (size_t j = 0; j < word_length; ++j) text->insert_char(word[j]);
+      for (size_t j = 0; j < word_length; ++j) text->backspace_char();
+    }
+  });
+
+  bench_run(prefix + "/insert_char+delete_char", 2 * chars, reload, [&] {
+    for (size_t i = positions.size(); i-- > 0;) {
+      text->cursor = positions[i];
+      for (size_t j = 0; j < word_length; ++j) text->insert_char(word[j]);
+      text->cursor = positions[i];
+      for (size_t j = 0; j < word_length; ++j) text->delete_char();
+    }
+  });
+
+  /* Undoing all edits and redoing them again also leaves the text unchanged. */
+  std::unique_ptr<text_buffer_t> undone = load(corpus.text);
+  for (size_t i = positions.size(); i-- > 0;) {
+    undone->cursor = positions[i];
+    for (size_t j = 0; j < word_length; ++j) undone->insert_char(word[j]);
+  }
+  bench_run(prefix + "/apply_undo+apply_redo", 2 * positions.size(), [&] {
+    for (size_t i = 0; i < positions.size(); ++i) undone->apply_undo();
+    for (size_t i = 0; i < positions.size(); ++i) undone->apply_redo();
+  });
+}
+
+void bench_find(const corpus_t &corpus) {
+  std::string prefix = std::string("find/") + corpus.name;
+  std::unique_ptr<text_buffer_t> text = load(corpus.text);
+  struct {
+    const char *name;
+    const char *needle;
+    int flags;
+  } searches[] = {
+      {"/plain-common", corpus.common, 0},
+      {"/plain-rare", corpus.rare, 0},
+      {"/icase-common", corpus.common, find_flags_t::ICASE},
+      {"/icase-rare", corpus.rare, find_flags_t::ICASE},
+      {"/regex", corpus.regex, find_flags_t::REGEX},
+  };
+
+  for (const auto &search : searches) {
+    std::string needle(search.needle);
+    finder_t finder(&needle, search.flags);
+    bench_run(prefix + search.name, corpus.text.size(), [&] {
+      size_t count = find_all(text.get(), &finder);
+      bench_use(count);
+    });
+  }
+}
+
+void bench_wrap(const corpus_t &corpus) {
+  static const int widths[] = {40, 80, 200};
+  std::unique_ptr<text_buffer_t> text = load(corpus.text);
+  edit_window_t edit_window(text.get());
+
+  for (int width : widths) {
+    std::string name = std::string("rewrap/") + corpus.name + "/" + std::to_string(width);
+    if (bench_options().filter != nullptr && name.find(bench_options().filter) == std::string::npos)
+      continue;
+    // The text area is two columns narrower than the window, due to the scrollbar.
+    edit_window.set_size(24, width + 2);
+
+    /* Switching the wrap type on rewraps the whole text. Only the time of the rewrap itself is
+       recorded, as switching also repositions the view. */
+    double best = 0, total = 0;
+    long runs = 0;
+    do {
+      edit_window.set_wrap(wrap_type_t::WORD);
+      double elapsed =
+          std::chrono::duration<double>(edit_window.get_stats().last_rewrap_time).count();
+      edit_window.set_wrap(wrap_type_t::NONE);
+      if (runs == 0 || elapsed < best) best = elapsed;
+      total += elapsed;
+      ++runs;
+    } while (total < bench_options().min_time);
+
+    bench_report(name, corpus.text.size(), runs, best);
+  }
+}
+
+void bench_paint(const corpus_t &corpus) {
+  std::unique_ptr<text_buffer_t> text = load(corpus.text);
+  std::unique_ptr<t3_window_t, void (*)(t3_window_t *)> window(
+      t3_win_new(nullptr, 1, 80, 0, 0, 0), t3_win_del);
+  const int lines = std::min(text->size(), 100000);
+  text_line_t::paint_info_t info;
+
+  info.start = 0;
+  info.leftcol = 0;
+  info.max = INT_MAX;
+  info.size = 80;
+  info.tabsize = 8;
+  info.flags = 0;
+  info.selection_start = -1;
+  info.selection_end = -1;
+  info.cursor = -1;
+  info.normal_attr = 0;
+  info.selected_attr = T3_ATTR_REVERSE;
+
+  bench_run(std::string("paint_line/") + corpus.name, lines, [&] {
+    for (int i = 0; i < lines; ++i) {
+      t3_win_set_paint(window.get(), 0, 0);
+      t3_win_clrtoeol(window.get());
+      text->paint_line(window.get(), i, &info);
+    }
+  });
+}
+
+void bench_convert_block(const corpus_t &corpus) {
+  std::unique_ptr<text_buffer_t> text = load(corpus.text);
+  text_coordinate_t start(0, 0);
+  text_coordinate_t end(text->size() - 1, text->get_line_max(text->size() - 1));
+
+  bench_run(std::string("convert_block/") + corpus.name, corpus.text.size(), [&] {
+    std::unique_ptr<std::string> block(text->convert_block(start, end));
+    bench_use(block->size());
+  });
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  bench_init(argc, argv);
+
+  std::unique_ptr<init_parameters_t> params(init_parameters_t::create());
+  params->program_name = "editing";
+  params->headless = true;
+  complex_error_t result = init(params.get());
+  if (!result.get_success()) {
+    fprintf(stderr, "Error initializing: %s\n", result.get_string());
+    return EXIT_FAILURE;
+  }
+
+  corpus_t corpora[] = {
+      {"source", generate_source(20000), "size", "std::string", "[a-z]+->[a-z_]+\\("},
+      {"cjk", generate_cjk(20000), "\xe4\xb8\x80", "\xe4\xb8\x80\xe4\xb8\x81",
+       "[\xe4\xb8\x80-\xe4\xb8\x8f]{2}"},
+      {"json", generate_json(4 << 20), "\"id\"", "\"item99999\"", "\"value\":[0-9]+\\.5"},
+      {"log", generate_log(1000000), "INFO", "chunk 255", "\\[(WARN|ERROR)\\]"},
+  };
+
+  for (const corpus_t &corpus : corpora) {
+    bench_run(std::string("load/") + corpus.name, corpus.text.size(), [&] {
+      std::unique_ptr<text_buffer_t> text = load(corpus.text);
+      bench_use(text->size());
+    });
+  }
+  for (const corpus_t &corpus : corpora) bench_editing(corpus);
+  for (const corpus_t &corpus : corpora) bench_find(corpus);
+  for (const corpus_t &corpus : corpora) bench_wrap(corpus);
+  for (const corpus_t &corpus : corpora) bench_paint(corpus);
+  for (const corpus_t &corpus : corpora) bench_convert_block(corpus);
+  return 0;
+}
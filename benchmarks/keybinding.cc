@@ -0,0 +1,113 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Micro benchmarks for key_bindings_t. The bindings used are the default bindings of
+   edit_window_t, and the key stream mixes bound keys, unbound plain characters and function
+   keys in roughly the proportions seen while typing. For comparison, the same lookups are done
+   on a std::map, which is how key_bindings_t stored its bindings before. */
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <t3widget/key_binding.h>
+
+#include "bench.h"
+
+using namespace t3_widget;
+
+namespace {
+
+enum Action {
+#define _T3_ACTION(action, ...) ACTION_##action,
+#include <t3widget/widgets/editwindow.actions.h>
+#undef _T3_ACTION
+};
+
+#define _T3_ACTION(action, name, ...) {ACTION_##action, name, {__VA_ARGS__}},
+key_bindings_t<Action> bindings{
+#include <t3widget/widgets/editwindow.actions.h>
+};
+#undef _T3_ACTION
+
+std::vector<key_t> generate_keys(size_t count) {
+  static const key_t function_keys[] = {EKEY_F1, EKEY_F5, EKEY_F12, EKEY_UP, EKEY_DOWN,
+                                        EKEY_HOME | EKEY_CTRL, EKEY_PGDN | EKEY_SHIFT};
+  std::mt19937 rng(1);
+  std::vector<key_t> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    unsigned kind = rng() % 10;
+    if (kind < 6) {
+      keys.push_back(' ' + rng() % 95);
+    } else if (kind < 8) {
+      keys.push_back(EKEY_CTRL | ('a' + rng() % 26));
+    } else if (kind < 9) {
+      keys.push_back(EKEY_META | ('0' + rng() % 10));
+    } else {
+      keys.push_back(function_keys[rng() % (sizeof(function_keys) / sizeof(function_keys[0]))]);
+    }
+  }
+  return keys;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  bench_init(argc, argv);
+
+  std::map<key_t, Action> map_bindings;
+  for (key_t key = 0; key < 128; ++key) {
+    for (key_t modifiers = 0; modifiers < 8; ++modifiers) {
+      key_t full_key = key | (modifiers << 28);
+      optional<Action> action = bindings.find_action(full_key);
+      if (action.is_valid()) map_bindings[full_key] = action;
+    }
+  }
+  for (key_t key = EKEY_FIRST_SPECIAL; key < EKEY_F1 + 64; ++key) {
+    for (key_t modifiers = 0; modifiers < 8; ++modifiers) {
+      key_t full_key = key | (modifiers << 28);
+      optional<Action> action = bindings.find_action(full_key);
+      if (action.is_valid()) map_bindings[full_key] = action;
+    }
+  }
+
+  std::vector<key_t> keys = generate_keys(1 << 16);
+
+  bench_run("key_bindings_t::find_action", keys.size(), [&] {
+    size_t found = 0;
+    for (key_t key : keys) found += bindings.find_action(key).is_valid();
+    bench_use(found);
+  });
+
+  bench_run("std::map::find", keys.size(), [&] {
+    size_t found = 0;
+    for (key_t key : keys) found += map_bindings.find(key) != map_bindings.end();
+    bench_use(found);
+  });
+
+  bench_run("key_bindings_t::names", bindings.names_size(), [&] {
+    size_t total = 0;
+    for (size_t i = 0; i < bindings.names_size(); ++i) total += bindings.names(i).size();
+    bench_use(total);
+  });
+
+  bench_run("key_bindings_t::map_name", bindings.names_size(), [&] {
+    size_t found = 0;
+    for (size_t i = 0; i < bindings.names_size(); ++i)
+      found += bindings.map_name(bindings.names(i)).is_valid();
+    bench_use(found);
+  });
+  return 0;
+}
@@ -0,0 +1,60 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Measure the heap memory used per text_line_t, for a million lines with a length distribution
+   resembling source code: one in seven lines is empty, the others are 20 to 59 bytes long.
+   Memory use is determined with the glibc mallinfo interface, and includes the allocator
+   overhead. */
+#include <cstdio>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+#include <t3widget/textline.h>
+
+using namespace t3_widget;
+
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#else
+  return static_cast<unsigned>(mallinfo().uordblks);
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  (void)argc;
+  (void)argv;
+  const int line_count = 1000000;
+  std::vector<text_line_t *> lines;
+  std::string text(64, 'x');
+
+  lines.reserve(line_count);
+  size_t before = heap_in_use();
+  for (int i = 0; i < line_count; ++i) {
+    int length = i % 7 == 0 ? 0 : 20 + (i * 7919) % 40;
+    if (length == 0) {
+      lines.push_back(default_text_line_factory.new_text_line_t());
+    } else {
+      lines.push_back(default_text_line_factory.new_text_line_t(text.data(), length));
+    }
+  }
+  size_t after = heap_in_use();
+
+  printf("{\"benchmark\": \"text_line_t memory\", \"lines\": %d, \"bytes_per_line\": %.1f}\n",
+         line_count, static_cast<double>(after - before) / line_count);
+
+  for (text_line_t *line : lines) delete line;
+  return 0;
+}
@@ -11,7 +11,11 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+
 #include "autocompleter.h"
+#include "key.h"
+#include "main.h"
 #include "textbuffer.h"
 #include "util.h"
 
@@ -19,4 +23,249 @@ namespace t3_widget {
 
 autocompleter_t::~autocompleter_t() {}
 
+//============================= word_autocompleter_t ========================
+
+word_autocompleter_t::word_autocompleter_t(text_buffer_t *text, size_t max_completions,
+                                           size_t min_word_length)
+    : impl(new implementation_t(max_completions, min_word_length)) {
+  set_text(text);
+}
+
+word_autocompleter_t::~word_autocompleter_t() { impl->lines_changed_connection.disconnect(); }
+
+void word_autocompleter_t::set_text(text_buffer_t *text) {
+  if (text == impl->text) return;
+
+  impl->lines_changed_connection.disconnect();
+  impl->words.clear();
+  impl->line_words.clear();
+  impl->text = text;
+  if (text == nullptr) return;
+
+  impl->lines_changed_connection =
+      text->connect_lines_edited(signals::mem_fun(this, &word_autocompleter_t::lines_edited));
+  impl->line_words.resize(text->size());
+  for (int i = 0; i < text->size(); ++i) add_line(i);
+}
+
+void word_autocompleter_t::add_line(int line) {
+  const text_line_t *data = impl->text->get_line_data(line);
+  std::vector<word_index_t::iterator> &line_words = impl->line_words[line];
+  int length = data->get_length();
+
+  for (int pos = 0; pos < length;) {
+    if (!data->is_alnum(pos)) {
+      pos = data->adjust_position(pos, 1);
+      continue;
+    }
+    int start = pos;
+    while (pos < length && data->is_alnum(pos)) pos = data->adjust_position(pos, 1);
+    if ((size_t)(pos - start) < impl->min_word_length) continue;
+
+    word_index_t::iterator word =
+        impl->words.insert(std::make_pair(data->get_data()->substr(start, pos - start), 0)).first;
+    word->second++;
+    line_words.push_back(word);
+  }
+}
+
+void word_autocompleter_t::remove_line(int line) {
+  for (word_index_t::iterator word : impl->line_words[line]) {
+    if (--word->second == 0) impl->words.erase(word);
+  }
+  impl->line_words[line].clear();
+}
+
+void word_autocompleter_t::lines_edited(int first, int old_count, int new_count) {
+  for (int i = first; i < first + old_count; ++i) remove_line(i);
+  if (new_count > old_count) {
+    impl->line_words.insert(impl->line_words.begin() + first + old_count, new_count - old_count,
+                            std::vector<word_index_t::iterator>());
+  } else if (new_count < old_count) {
+    impl->line_words.erase(impl->line_words.begin() + first + new_count,
+                           impl->line_words.begin() + first + old_count);
+  }
+  for (int i = first; i < first + new_count; ++i) add_line(i);
+}
+
+string_list_base_t *word_autocompleter_t::build_autocomplete_list(const text_buffer_t *text,
+                                                                  int *position) {
+  /* The index is maintained through the lines_edited signal, which can only be connected
+     through a non-const text_buffer_t. Indexing does not change the text. */
+  set_text(const_cast<text_buffer_t *>(text));
+
+  const text_line_t *line = text->get_line_data(text->cursor.line);
+  int start = text->cursor.pos;
+  while (start > 0) {
+    int previous = line->adjust_position(start, -1);
+    if (!line->is_alnum(previous)) break;
+    start = previous;
+  }
+  if (start == text->cursor.pos) return nullptr;
+
+  impl->prefix = line->get_data()->substr(start, text->cursor.pos - start);
+
+  /* Collect all words starting with the prefix, other than the prefix itself. */
+  std::vector<word_index_t::const_iterator> candidates;
+  for (word_index_t::const_iterator iter = impl->words.upper_bound(impl->prefix);
+       iter != impl->words.end() && iter->first.compare(0, impl->prefix.size(), impl->prefix) == 0;
+       ++iter) {
+    candidates.push_back(iter);
+  }
+  if (candidates.empty()) return nullptr;
+
+  size_t count = std::min(candidates.size(), impl->max_completions);
+  std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                    [](word_index_t::const_iterator a, word_index_t::const_iterator b) {
+                      return a->second > b->second ||
+                             (a->second == b->second && a->first < b->first);
+                    });
+
+  impl->completions.words.clear();
+  for (size_t i = 0; i < count; ++i) impl->completions.words.push_back(candidates[i]->first);
+  *position = start;
+  return &impl->completions;
+}
+
+void word_autocompleter_t::autocomplete(text_buffer_t *text, size_t idx) {
+  if (idx >= impl->completions.words.size()) return;
+  std::string suffix = impl->completions.words[idx].substr(impl->prefix.size());
+  text->insert_block(&suffix);
+}
+
+size_t word_autocompleter_t::completion_list_t::size() const { return words.size(); }
+
+const std::string *word_autocompleter_t::completion_list_t::operator[](size_t idx) const {
+  return &words[idx];
+}
+
+//============================= async_autocompleter_t ========================
+
+async_autocompleter_t::async_autocompleter_t(int worker_count)
+    : impl(new implementation_t(worker_count < 1 ? 1 : worker_count)) {
+  impl->update_connection = connect_update_notification(
+      signals::mem_fun(this, &async_autocompleter_t::update_notification));
+}
+
+async_autocompleter_t::~async_autocompleter_t() {
+  stop_workers();
+  impl->update_connection.disconnect();
+}
+
+void async_autocompleter_t::stop_workers() {
+  {
+    std::unique_lock<std::mutex> l(impl->lock);
+    if (impl->stopping) return;
+    impl->stopping = true;
+    impl->current_generation++;
+  }
+  impl->request_available.notify_all();
+  for (std::thread &worker : impl->workers) worker.join();
+  impl->workers.clear();
+}
+
+void async_autocompleter_t::worker() {
+  std::unique_lock<std::mutex> l(impl->lock);
+  while (true) {
+    impl->request_available.wait(l, [this] { return impl->stopping || impl->request_queued; });
+    if (impl->stopping) return;
+
+    request_t request = impl->request;
+    impl->request_queued = false;
+    l.unlock();
+
+    std::vector<std::string> results;
+    int position = request.cursor.pos;
+    find_completions(request, &results, &position);
+
+    l.lock();
+    if (request.is_cancelled()) continue;
+    impl->results.swap(results);
+    impl->results_position = position;
+    impl->results_ready = true;
+    signal_update();
+  }
+}
+
+void async_autocompleter_t::update_notification() {
+  {
+    std::unique_lock<std::mutex> l(impl->lock);
+    if (!impl->results_ready || impl->results_announced) return;
+    impl->results_announced = true;
+  }
+  completions_ready();
+}
+
+string_list_base_t *async_autocompleter_t::build_autocomplete_list(const text_buffer_t *text,
+                                                                   int *position) {
+  std::string line =
+      text->get_line_data(text->cursor.line)->get_data()->substr(0, text->cursor.pos);
+
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (impl->stopping) return nullptr;
+
+  if (impl->request.text == text && impl->request.cursor == text->cursor &&
+      impl->request.line == line) {
+    if (!impl->results_ready) return nullptr;
+    impl->completions.words = impl->results;
+    impl->completions_position = impl->results_position;
+    impl->completions_request = impl->request;
+    l.unlock();
+
+    if (impl->completions.words.empty()) return nullptr;
+    *position = impl->completions_position;
+    return &impl->completions;
+  }
+
+  /* Replace the previous request, if any. A request that has already been picked up by a worker
+     notices through request_t::is_cancelled that it has been superseded. */
+  impl->request.text = text;
+  impl->request.cursor = text->cursor;
+  impl->request.line.swap(line);
+  impl->request.generation = ++impl->current_generation;
+  impl->request.current_generation = &impl->current_generation;
+  impl->request_queued = true;
+  impl->results_ready = false;
+  impl->results_announced = false;
+  impl->results.clear();
+
+  while (impl->workers.size() < static_cast<size_t>(impl->worker_count))
+    impl->workers.push_back(std::thread(&async_autocompleter_t::worker, this));
+  l.unlock();
+  impl->request_available.notify_one();
+  return nullptr;
+}
+
+bool async_autocompleter_t::is_pending() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->request.text != nullptr && !impl->results_ready && !impl->stopping;
+}
+
+void async_autocompleter_t::cancel() {
+  std::unique_lock<std::mutex> l(impl->lock);
+  impl->current_generation++;
+  impl->request = request_t();
+  impl->request_queued = false;
+  impl->results_ready = false;
+  impl->results.clear();
+}
+
+void async_autocompleter_t::autocomplete(text_buffer_t *text, size_t idx) {
+  if (idx >= impl->completions.words.size()) return;
+  /* The cursor may have moved since the completions were determined. Only complete if the text
+     to be replaced is still on the cursor line before the cursor. */
+  const request_t &request = impl->completions_request;
+  if (request.text != text || request.cursor.line != text->cursor.line ||
+      impl->completions_position > text->cursor.pos)
+    return;
+  text->replace_block(text_coordinate_t(text->cursor.line, impl->completions_position),
+                      text->cursor, &impl->completions.words[idx]);
+}
+
+size_t async_autocompleter_t::completion_list_t::size() const { return words.size(); }
+
+const std::string *async_autocompleter_t::completion_list_t::operator[](size_t idx) const {
+  return &words[idx];
+}
+
 };  // namespace
@@ -14,6 +14,14 @@
 #ifndef T3_WIDGET_AUTOCOMPLETER_H
 #define T3_WIDGET_AUTOCOMPLETER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <t3widget/contentlist.h>
 #include <t3widget/textbuffer.h>
 
@@ -26,6 +34,197 @@ class T3_WIDGET_API autocompleter_t {
   virtual void autocomplete(text_buffer_t *text, size_t idx) = 0;
 };
 
+/** Autocompleter which completes the word before the cursor from the words in the text.
+
+    The words in the text are kept in an index, which is updated incrementally as lines of the
+    text change. Completions are ordered by the number of occurences of the word in the text.
+    The index is built for the text passed to #set_text, or the first time completions are
+    requested for a text. The autocompleter must be detached from a text, by calling #set_text
+    with a different text or @c NULL, before that text is destroyed.
+*/
+class T3_WIDGET_API word_autocompleter_t : public autocompleter_t {
+ public:
+  /** Create a new word_autocompleter_t.
+      @param text The text to index, or @c NULL.
+      @param max_completions The maximum number of completions offered.
+      @param min_word_length The minimum length in bytes of words offered as completion.
+  */
+  word_autocompleter_t(text_buffer_t *text = NULL, size_t max_completions = 20,
+                       size_t min_word_length = 3);
+  ~word_autocompleter_t() override;
+
+  /** Set the text for which to maintain the index. */
+  void set_text(text_buffer_t *text);
+
+  string_list_base_t *build_autocomplete_list(const text_buffer_t *text, int *position) override;
+  void autocomplete(text_buffer_t *text, size_t idx) override;
+
+ private:
+  /* Number of occurences of each word in the text. The index is ordered, such that all words
+     with a given prefix are adjacent. */
+  typedef std::map<std::string, size_t> word_index_t;
+
+  class T3_WIDGET_LOCAL completion_list_t : public string_list_base_t {
+   public:
+    std::vector<std::string> words;
+
+    size_t size() const override;
+    const std::string *operator[](size_t idx) const override;
+  };
+
+  struct T3_WIDGET_LOCAL implementation_t {
+    text_buffer_t *text;
+    signals::connection lines_changed_connection;
+    word_index_t words;
+    /* The words on each line of the text, as iterators into #words. */
+    std::vector<std::vector<word_index_t::iterator>> line_words;
+    size_t max_completions, min_word_length;
+    /* The prefix for which #completions was built. */
+    std::string prefix;
+    completion_list_t completions;
+
+    implementation_t(size_t _max_completions, size_t _min_word_length)
+        : text(NULL), max_completions(_max_completions), min_word_length(_min_word_length) {}
+  };
+  pimpl_ptr<implementation_t>::t impl;
+
+  void lines_edited(int first, int old_count, int new_count);
+  void add_line(int line);
+  void remove_line(int line);
+};
+
+/** Autocompleter which determines the completions on worker threads.
+
+    Completion sources like large symbol tables or directory scans can take too long to query
+    while processing a key. This class instead passes a copy of the line up to the cursor to a
+    pool of worker threads, which call #find_completions. While a request is outstanding,
+    #build_autocomplete_list returns @c NULL and #is_pending returns @c true. When the results
+    are available, the main loop is woken through #signal_update, and the @c completions_ready
+    signal is emitted from the thread running #main_loop. A subsequent call to
+    #build_autocomplete_list for the same text and cursor position returns the results.
+
+    Each new request supersedes the previous one. Requests which have not been started yet are
+    dropped, and running requests can detect that they have been superseded through
+    request_t::is_cancelled. Results of superseded requests are discarded.
+
+    Derived classes must call #stop_workers from their destructor, as the worker threads may
+    otherwise call #find_completions on a partially destroyed object.
+*/
+class T3_WIDGET_API async_autocompleter_t : public autocompleter_t {
+ public:
+  /** A request for completions, as passed to #find_completions. */
+  class T3_WIDGET_API request_t {
+   public:
+    /** The text buffer for which the completions are requested.
+        This is only provided to identify the text. It must not be accessed from the worker
+        threads, as the text may be modified concurrently on the thread running #main_loop.
+    */
+    const text_buffer_t *text;
+    /** The position of the cursor. */
+    text_coordinate_t cursor;
+    /** The contents of the cursor line, up to the cursor. */
+    std::string line;
+
+    request_t() : text(NULL), cursor(0, 0), generation(0), current_generation(NULL) {}
+
+    /** Check whether the request has been superseded by a newer request.
+        Implementations of #find_completions which take a significant amount of time should
+        check this regularly, and return as soon as possible once it returns @c true.
+    */
+    bool is_cancelled() const { return *current_generation != generation; }
+
+   private:
+    friend class async_autocompleter_t;
+    unsigned long generation;
+    const std::atomic<unsigned long> *current_generation;
+  };
+
+  /** Create a new async_autocompleter_t.
+      @param worker_count The number of worker threads to use.
+
+      The worker threads are only started when the first request is made.
+  */
+  async_autocompleter_t(int worker_count = 1);
+  ~async_autocompleter_t() override;
+
+  string_list_base_t *build_autocomplete_list(const text_buffer_t *text, int *position) override;
+  void autocomplete(text_buffer_t *text, size_t idx) override;
+
+  /** Check whether a request is outstanding for which the results have not been retrieved. */
+  bool is_pending() const;
+  /** Cancel the outstanding request, if any. */
+  void cancel();
+
+  /** Emitted on the thread running #main_loop when the results of a request are available. */
+  T3_WIDGET_SIGNAL(completions_ready, void);
+
+ protected:
+  /** Determine the completions for a request.
+      @param request The request to complete.
+      @param completions The location to store the completions.
+      @param position The location to store the start of the text to be replaced by a
+          completion, as a byte offset in the line. Initially set to the cursor position.
+
+      This function is called on one of the worker threads. If no completions are stored, the
+      completion attempt is considered to have failed.
+  */
+  virtual void find_completions(const request_t &request, std::vector<std::string> *completions,
+                                int *position) = 0;
+
+  /** Stop the worker threads, and wait for any running request to finish. */
+  void stop_workers();
+
+ private:
+  class T3_WIDGET_LOCAL completion_list_t : public string_list_base_t {
+   public:
+    std::vector<std::string> words;
+
+    size_t size() const override;
+    const std::string *operator[](size_t idx) const override;
+  };
+
+  struct T3_WIDGET_LOCAL implementation_t {
+    int worker_count;
+    std::vector<std::thread> workers;
+    signals::connection update_connection;
+
+    /* Protects all members below, except #current_generation and #completions. */
+    std::mutex lock;
+    std::condition_variable request_available;
+    bool stopping;
+    /* Generation of the most recent request. Only written with #lock held, but read without by
+       request_t::is_cancelled. */
+    std::atomic<unsigned long> current_generation;
+    /* The most recent request, and whether it has been picked up by a worker. */
+    request_t request;
+    bool request_queued;
+    /* Whether the results for the most recent request are available, and have been announced
+       through the completions_ready signal. */
+    bool results_ready, results_announced;
+    std::vector<std::string> results;
+    int results_position;
+
+    /* Results handed out by build_autocomplete_list. Only accessed from the main thread. */
+    completion_list_t completions;
+    request_t completions_request;
+    int completions_position;
+
+    implementation_t(int _worker_count)
+        : worker_count(_worker_count),
+          stopping(false),
+          current_generation(0),
+          request_queued(false),
+          results_ready(false),
+          results_announced(false),
+          results_position(0),
+          completions_position(0) {}
+  };
+  pimpl_ptr<implementation_t>::t impl;
+
+  void worker();
+  void update_notification();
+};
+
 };  // namespace
 
 #endif
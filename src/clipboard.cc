@@ -54,6 +54,7 @@ static signals::connection init_connected =
     See lock_clipboard for details.
 */
 linked_ptr<std::string>::t get_clipboard() {
+  trace_scope_t trace("get_clipboard");
   if (extclipboard_calls != nullptr) return extclipboard_calls->get_selection(true);
   return clipboard_data;
 }
@@ -64,11 +65,13 @@ linked_ptr<std::string>::t get_clipboard() {
     See lock_clipboard for details.
 */
 linked_ptr<std::string>::t get_primary() {
+  trace_scope_t trace("get_primary");
   if (extclipboard_calls != nullptr) return extclipboard_calls->get_selection(false);
   return primary_data;
 }
 
 void set_clipboard(std::string *str) {
+  trace_scope_t trace("set_clipboard");
   if (str != nullptr && str->size() == 0) {
     delete str;
     str = nullptr;
@@ -95,6 +98,7 @@ void set_clipboard(std::string *str) {
 }
 
 void set_primary(std::string *str) {
+  trace_scope_t trace("set_primary");
   if (str != nullptr && str->size() == 0) {
     delete str;
     str = nullptr;
@@ -118,25 +122,27 @@ static void init_external_clipboard(bool init) {
     if (lt_dlinit() != 0) return;
 
     if ((extclipboard_mod = lt_dlopen(X11_MOD_NAME)) == nullptr) {
-      lprintf("Could not open external clipboard module (X11): %s\n", X11_MOD_NAME);
+      lcprintf(LOG_CLIPBOARD, LOG_ERROR, "Could not open external clipboard module (X11): %s\n",
+               X11_MOD_NAME);
       return;
     }
 
     if ((extclipboard_calls = (extclipboard_interface_t *)lt_dlsym(
              extclipboard_mod, "_t3_widget_extclipboard_calls")) == nullptr) {
-      lprintf("External clipboard module does not export interface symbol\n");
+      lcprintf(LOG_CLIPBOARD, LOG_ERROR,
+               "External clipboard module does not export interface symbol\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_mod = nullptr;
       return;
     }
     if (extclipboard_calls->version != EXTCLIPBOARD_VERSION) {
-      lprintf("External clipboard module has incompatible version\n");
+      lcprintf(LOG_CLIPBOARD, LOG_ERROR, "External clipboard module has incompatible version\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_mod = nullptr;
       return;
     }
     if (!extclipboard_calls->init()) {
-      lprintf("Failed to initialize external clipboard module\n");
+      lcprintf(LOG_CLIPBOARD, LOG_ERROR, "Failed to initialize external clipboard module\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_calls = nullptr;
     }
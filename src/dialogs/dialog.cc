@@ -73,7 +73,8 @@ bool dialog_t::process_key(key_t key) {
   }
 
   if ((key & EKEY_META) || key == EKEY_F10) {
-    for (widgets_t::iterator iter = widgets.begin(); iter != widgets.end(); iter++) {
+    for (size_t idx : get_hotkey_candidates(key & ~EKEY_META)) {
+      widgets_t::iterator iter = widgets.begin() + idx;
       widget_container_t *widget_container;
       widget_t *hotkey_target;
 
@@ -164,8 +165,33 @@ void dialog_t::set_active_popup(popup_t *popup) {
   if (prev_active != nullptr) prev_active->dialog_base_t::hide();
 }
 
+/* Check whether @p dialog is completely covered by one of the dialogs in [@p begin, @p end). */
+static bool is_covered(dialog_t *dialog, dialogs_t::const_iterator begin,
+                       dialogs_t::const_iterator end) {
+  const t3_window_t *window = dialog->get_base_window();
+  int top = t3_win_get_abs_y(window), left = t3_win_get_abs_x(window);
+  int bottom = top + t3_win_get_height(window), right = left + t3_win_get_width(window);
+
+  for (; begin != end; ++begin) {
+    const t3_window_t *cover = (*begin)->get_base_window();
+    int cover_top = t3_win_get_abs_y(cover), cover_left = t3_win_get_abs_x(cover);
+    if (cover_top <= top && cover_left <= left &&
+        cover_top + t3_win_get_height(cover) >= bottom &&
+        cover_left + t3_win_get_width(cover) >= right)
+      return true;
+  }
+  return false;
+}
+
 void dialog_t::update_dialogs() {
-  for (dialog_t *active_dialog : dialog_t::active_dialogs) active_dialog->update_contents();
+  for (dialogs_t::const_iterator iter = active_dialogs.begin(); iter != active_dialogs.end();
+       ++iter) {
+    /* Updating a dialog which is completely covered by a dialog higher in the stack has no
+       visible effect. Any pending changes are painted once it is uncovered, because the
+       redraw state of the dialog and its widgets is left untouched. */
+    if (is_covered(*iter, std::next(iter), active_dialogs.cend())) continue;
+    (*iter)->update_contents();
+  }
   if (active_popup) active_popup->update_contents();
 }
 
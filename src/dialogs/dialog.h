@@ -27,6 +27,8 @@ class complex_error_t;
 class T3_WIDGET_API dialog_t : public dialog_base_t {
  private:
   friend void iterate();
+  friend void process_input_key(key_t key);
+  friend int headless_update(int wait_msec);
   friend bool mouse_target_t::handle_mouse_event(mouse_event_t event);
   // main_window_base_t should be allowed to call dialog_t(), but no others should
   friend class main_window_base_t;
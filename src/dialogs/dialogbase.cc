@@ -34,7 +34,8 @@ void dialog_base_t::init(bool _init) {
   }
 }
 
-dialog_base_t::dialog_base_t(int height, int width, bool has_shadow) : redraw(true) {
+dialog_base_t::dialog_base_t(int height, int width, bool has_shadow)
+    : hotkey_index_generation(0), hotkey_index_size(0), redraw(true) {
   if ((window = t3_win_new(nullptr, height, width, 0, 0, 0)) == nullptr) throw std::bad_alloc();
   if (has_shadow) {
     if ((shadow_window = t3_win_new(nullptr, height, width, 1, 1, 1)) == nullptr)
@@ -50,7 +51,10 @@ dialog_base_t::dialog_base_t(int height, int width, bool has_shadow) : redraw(tr
 
     This constructor should only be called by ::main_window_base_t (through ::dialog_t).
 */
-dialog_base_t::dialog_base_t() : redraw(false) { dialog_base_list.push_back(this); }
+dialog_base_t::dialog_base_t()
+    : hotkey_index_generation(0), hotkey_index_size(0), redraw(false) {
+  dialog_base_list.push_back(this);
+}
 
 dialog_base_t::~dialog_base_t() {
   for (dialog_base_list_t::iterator iter = dialog_base_list.begin(); iter != dialog_base_list.end();
@@ -109,7 +113,10 @@ void dialog_base_t::update_contents() {
     }
   }
 
-  for (widget_t *widget : widgets) widget->update_contents();
+  /* Hidden widgets are not visible, so updating them can wait until they are shown again. */
+  for (widget_t *widget : widgets) {
+    if (widget->is_shown()) widget->update_contents();
+  }
 }
 
 void dialog_base_t::set_focus(focus_t focus) {
@@ -200,6 +207,29 @@ void dialog_base_t::push_back(widget_t *widget) {
   if (!set_widget_parent(widget)) return;
   if (widgets.size() > 0 && widgets.front() == dummy) widgets.pop_front();
   widgets.push_back(widget);
+  invalidate_hotkey_index();
+}
+
+const std::vector<size_t> &dialog_base_t::get_hotkey_candidates(key_t key) {
+  /* Changes to the widget list are signalled through invalidate_hotkey_index. The size is
+     checked as well, for derived classes which change #widgets without calling it. Changes to
+     the hotkeys of the widgets themselves are signalled through the hotkey generation. */
+  if (hotkey_index_size != widgets.size() ||
+      hotkey_index_generation != widget_t::get_hotkey_generation()) {
+    hotkey_index.clear();
+    hotkey_index_size = widgets.size();
+    hotkey_index_generation = widget_t::get_hotkey_generation();
+  }
+
+  auto result = hotkey_index.emplace(key, std::vector<size_t>());
+  if (result.second) {
+    std::vector<size_t> &candidates = result.first->second;
+    for (size_t i = 0; i < widgets.size(); ++i) {
+      if (dynamic_cast<container_t *>(widgets[i]) != nullptr || widgets[i]->is_hotkey(key))
+        candidates.push_back(i);
+    }
+  }
+  return result.first->second;
 }
 
 void dialog_base_t::force_redraw() {
@@ -16,6 +16,8 @@
 #define T3_DIALOG_BASE_H
 
 #include <list>
+#include <unordered_map>
+#include <vector>
 #include <t3widget/interfaces.h>
 #include <t3widget/widgets/dummywidget.h>
 #include <t3widget/widgets/widget.h>
@@ -38,6 +40,12 @@ class T3_WIDGET_API dialog_base_t : public virtual window_component_t, public co
   static signals::connection init_connected; /**< Dummy value to allow static connection of the @c
                                                 on_init signal to #init. */
 
+  /** Indices in #widgets of the widgets which may handle a hotkey, built on demand per key. */
+  std::unordered_map<key_t, std::vector<size_t>> hotkey_index;
+  /** Hotkey generation and number of widgets for which #hotkey_index is valid. */
+  unsigned hotkey_index_generation;
+  size_t hotkey_index_size;
+
   /** Default constructor, made private to avoid use. */
   dialog_base_t();
 
@@ -59,6 +67,23 @@ class T3_WIDGET_API dialog_base_t : public virtual window_component_t, public co
       If a widget is not added through #push_back, it will not be
       displayed, or receive input. */
   void push_back(widget_t *widget);
+  /** Invalidate the hotkey index of this dialog.
+
+      Must be called after every change to #widgets. Changes to the hotkeys of the widgets
+      themselves are signalled through widget_t::invalidate_hotkeys instead.
+  */
+  void invalidate_hotkey_index() {
+    hotkey_index_size = 0;
+    hotkey_index.clear();
+  }
+  /** Get the indices in #widgets of the widgets which may handle hotkey @p key.
+
+      The result contains, in order, all widgets for which widget_t::is_hotkey returned
+      @c true for @p key when the index was built, and all widgets which are a container_t (as
+      their hotkeys depend on the state of their children). The callers must still check the
+      state of the widgets, and call widget_t::is_hotkey to confirm.
+  */
+  const std::vector<size_t> &get_hotkey_candidates(key_t key);
 
   bool is_child(window_component_t *widget) override;
   void set_child_focus(window_component_t *target) override;
@@ -106,7 +106,10 @@ file_dialog_t::file_dialog_t(int height, int width, const char *_title)
 
 widget_t *file_dialog_t::get_anchor_widget() { return impl->show_hidden_label; }
 
-void file_dialog_t::insert_extras(widget_t *widget) { widgets.insert(widgets.end() - 2, widget); }
+void file_dialog_t::insert_extras(widget_t *widget) {
+  widgets.insert(widgets.end() - 2, widget);
+  invalidate_hotkey_index();
+}
 
 void file_dialog_t::set_options_widget(widget_t *options) {
   focus_widget_t *focus_widget;
@@ -103,7 +103,7 @@ void insert_char_dialog_t::ok_activate() {
   key_t key = interpret_key(description_line->get_text());
   if (key >= 0) {
     hide();
-    lprintf("Inserting key: %d\n", key);
+    lcprintf(LOG_WIDGETS, LOG_DEBUG, "Inserting key: %d\n", key);
     insert_protected_key(key);
   } else {
     std::string message = _("Invalid character description: '");
@@ -64,7 +64,8 @@ bool menu_panel_t::process_key(key_t key) {
       (*current_widget)->process_key(key);
       break;
     default:
-      for (widgets_t::iterator iter = widgets.begin(); iter != widgets.end(); iter++) {
+      for (size_t idx : get_hotkey_candidates(key)) {
+        widgets_t::iterator iter = widgets.begin() + idx;
         if ((*iter)->accepts_focus() && (*iter)->is_hotkey(key)) {
           (*current_widget)->set_focus(window_component_t::FOCUS_OUT);
           current_widget = iter;
@@ -152,11 +153,11 @@ menu_item_base_t *menu_panel_t::replace_item(menu_item_base_t *old_item, menu_it
   for (iter = widgets.begin(); iter != widgets.end(); iter++) {
     if ((*iter) == old_item) {
       unset_widget_parent(old_item);
-      if (new_item == nullptr) {
+      if (new_item == nullptr)
         widgets.erase(iter);
-      } else {
+      else
         *iter = new_item;
-      }
+      invalidate_hotkey_index();
       goto resize_panel;
     }
   }
@@ -0,0 +1,427 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cerrno>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef HAS_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include "internal.h"
+#include "main.h"
+
+/* File descriptor watches and timers registered by the application. The input
+   thread (read_keys in key.cc) waits for the watched file descriptors, and uses
+   the first timer expiry as its timeout. When a file descriptor is ready or a
+   timer expires, the source is marked pending and an EKEY_EVENT_SOURCE key is
+   queued. The callbacks are then run on the thread running the main loop, by
+   dispatch_event_sources. Pending sources are not waited for by the input
+   thread until their callback has run, to prevent queueing the same event over
+   and over again.
+
+   When using epoll, the file descriptors are added to the epoll set of the
+   input thread when the watch is created, using EPOLLONESHOT. This disables the
+   watch when it triggers, and it is re-armed after the callback has run. When
+   using select, the sets of file descriptors are rebuilt by the input thread
+   for every call to select. */
+
+namespace t3_widget {
+
+typedef std::chrono::steady_clock event_clock_t;
+
+/* Value for pending_events of expired timers. */
+#define TIMER_EXPIRED 1
+
+namespace {
+class event_source_t : public signals::internal::func_ptr_base {
+ public:
+  void disconnect() override;
+  bool is_valid() override;
+
+  virtual void call(int events) = 0;
+
+  bool removed = false;
+  /* Events which caused the source to be marked pending. Zero if the source is not pending. */
+  int pending_events = 0;
+};
+
+class fd_watch_t : public event_source_t {
+ public:
+  fd_watch_t(int _fd, int _events, const signals::slot<void, int> &_callback)
+      : fd(_fd), events(_events), callback(_callback) {}
+  void call(int _events) override { callback(_events); }
+
+  int fd;
+  int events;
+#ifdef HAS_EPOLL
+  /* Identifier used in the epoll set. */
+  uint64_t id = 0;
+  /* Set for file descriptors which epoll does not support, like regular files. Like select, these
+     are considered to be ready at all times. */
+  bool always_ready = false;
+#endif
+
+ private:
+  signals::slot<void, int> callback;
+};
+
+class timer_source_t : public event_source_t {
+ public:
+  timer_source_t(int msec, bool repeat, const signals::slot<void> &_callback)
+      : interval(std::chrono::milliseconds(msec)),
+        expiry(event_clock_t::now() + interval),
+        repeating(repeat),
+        callback(_callback) {}
+  void call(int) override { callback(); }
+
+  event_clock_t::duration interval;
+  event_clock_t::time_point expiry;
+  bool repeating;
+
+ private:
+  signals::slot<void> callback;
+};
+}  // namespace
+
+static std::mutex event_source_lock;
+static std::list<std::shared_ptr<fd_watch_t>> fd_watches;
+static std::list<std::shared_ptr<timer_source_t>> timers;
+
+#ifdef HAS_EPOLL
+static int epoll_fd = -1;
+static uint64_t next_watch_id = EPOLL_FIRST_EVENT_SOURCE_ID;
+
+/* Add, re-arm or remove a watch in the epoll set. Must be called with event_source_lock held. */
+static void epoll_update_watch(fd_watch_t *watch, int op) {
+  struct epoll_event event;
+
+  if (epoll_fd < 0) return;
+
+  event.events = EPOLLONESHOT;
+  if (watch->events & EWATCH_READ) event.events |= EPOLLIN;
+  if (watch->events & EWATCH_WRITE) event.events |= EPOLLOUT;
+  event.data.u64 = watch->id;
+  if (watch->always_ready || epoll_ctl(epoll_fd, op, watch->fd, &event) == 0) return;
+
+  /* Removal of a watch for a file descriptor which has already been closed fails, but the
+     file descriptor is then removed from the epoll set anyway. */
+  if (op == EPOLL_CTL_DEL) return;
+  if (errno == EPERM) {
+    watch->always_ready = true;
+    signal_event_sources_changed();
+    return;
+  }
+  lcprintf(LOG_GENERAL, LOG_ERROR, "Could not update epoll set for fd %d: %s\n", watch->fd,
+           strerror(errno));
+}
+#endif
+
+void event_source_t::disconnect() {
+  {
+    std::unique_lock<std::mutex> l(event_source_lock);
+    if (removed) return;
+    removed = true;
+#ifdef HAS_EPOLL
+    fd_watch_t *watch = dynamic_cast<fd_watch_t *>(this);
+    if (watch != nullptr) {
+      epoll_update_watch(watch, EPOLL_CTL_DEL);
+      return;
+    }
+#endif
+  }
+  signal_event_sources_changed();
+}
+
+bool event_source_t::is_valid() {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  return !removed;
+}
+
+signals::connection watch_fd(int fd, int events, const signals::slot<void, int> &slot) {
+  std::shared_ptr<fd_watch_t> watch(new fd_watch_t(fd, events, slot));
+  {
+    std::unique_lock<std::mutex> l(event_source_lock);
+    fd_watches.push_back(watch);
+#ifdef HAS_EPOLL
+    watch->id = next_watch_id++;
+    epoll_update_watch(watch.get(), EPOLL_CTL_ADD);
+#endif
+  }
+#ifndef HAS_EPOLL
+  signal_event_sources_changed();
+#endif
+  return signals::connection(watch);
+}
+
+signals::connection add_timer(int msec, bool repeat, const signals::slot<void> &slot) {
+  std::shared_ptr<timer_source_t> timer(new timer_source_t(msec < 0 ? 0 : msec, repeat, slot));
+  {
+    std::unique_lock<std::mutex> l(event_source_lock);
+    timers.push_back(timer);
+  }
+  signal_event_sources_changed();
+  return signals::connection(timer);
+}
+
+template <typename T>
+static void remove_disconnected(std::list<std::shared_ptr<T>> &sources) {
+  for (auto iter = sources.begin(); iter != sources.end();) {
+    if ((*iter)->removed)
+      iter = sources.erase(iter);
+    else
+      ++iter;
+  }
+}
+
+/* Find the expiry time of the first timer which is not pending. Must be called with
+   event_source_lock held. */
+static bool get_first_expiry(event_clock_t::time_point *first_expiry) {
+  bool have_timer = false;
+
+  for (const std::shared_ptr<timer_source_t> &timer : timers) {
+    if (timer->pending_events != 0) continue;
+    if (!have_timer || timer->expiry < *first_expiry) *first_expiry = timer->expiry;
+    have_timer = true;
+  }
+  return have_timer;
+}
+
+/* Mark all expired timers as pending. Must be called with event_source_lock held. */
+static bool mark_expired_timers() {
+  event_clock_t::time_point now = event_clock_t::now();
+  bool result = false;
+
+  for (const std::shared_ptr<timer_source_t> &timer : timers) {
+    if (timer->removed || timer->pending_events != 0 || timer->expiry > now) continue;
+    timer->pending_events = TIMER_EXPIRED;
+    result = true;
+  }
+  return result;
+}
+
+/* Calculate the time to wait for the first timer to expire, rounded up to a multiple of
+   @p Unit, such that we don't wake up just before the timer expires. */
+template <typename Unit>
+static typename Unit::rep time_to_expiry(event_clock_t::time_point expiry) {
+  event_clock_t::duration wait = expiry - event_clock_t::now();
+  if (wait < event_clock_t::duration::zero()) return 0;
+  return std::chrono::duration_cast<Unit>(wait + Unit(1) - event_clock_t::duration(1)).count();
+}
+
+#ifdef HAS_EPOLL
+void init_event_sources(int _epoll_fd) {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  epoll_fd = _epoll_fd;
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (!watch->removed) epoll_update_watch(watch.get(), EPOLL_CTL_ADD);
+  }
+}
+
+void cleanup_event_sources() {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  epoll_fd = -1;
+}
+
+int get_event_sources_timeout() {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  event_clock_t::time_point first_expiry;
+
+  remove_disconnected(fd_watches);
+  remove_disconnected(timers);
+
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (watch->always_ready && watch->pending_events == 0) return 0;
+  }
+
+  if (!get_first_expiry(&first_expiry)) return -1;
+  return time_to_expiry<std::chrono::milliseconds>(first_expiry);
+}
+
+bool check_event_source(uint64_t id, uint32_t events) {
+  std::unique_lock<std::mutex> l(event_source_lock);
+
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (watch->id != id) continue;
+    if (watch->removed || watch->pending_events != 0) return false;
+    if ((watch->events & EWATCH_READ) && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+      watch->pending_events |= EWATCH_READ;
+    if ((watch->events & EWATCH_WRITE) && (events & (EPOLLOUT | EPOLLERR)))
+      watch->pending_events |= EWATCH_WRITE;
+    if (watch->pending_events != 0) return true;
+    /* Not an event we are interested in. As the watch is disabled by EPOLLONESHOT, re-arm it. */
+    epoll_update_watch(watch.get(), EPOLL_CTL_MOD);
+    return false;
+  }
+  return false;
+}
+
+bool check_event_source_timers() {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  bool result = false;
+
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (!watch->always_ready || watch->removed || watch->pending_events != 0) continue;
+    watch->pending_events = watch->events & (EWATCH_READ | EWATCH_WRITE);
+    if (watch->pending_events != 0) result = true;
+  }
+
+  if (mark_expired_timers()) result = true;
+  return result;
+}
+#else
+struct timeval *fd_set_event_sources(fd_set *readset, fd_set *writeset, int *max_fd,
+                                     struct timeval *timeout) {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  event_clock_t::time_point first_expiry;
+
+  remove_disconnected(fd_watches);
+  remove_disconnected(timers);
+
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (watch->pending_events != 0 || watch->fd < 0 || watch->fd >= FD_SETSIZE) continue;
+    if (watch->events & EWATCH_READ) FD_SET(watch->fd, readset);
+    if (watch->events & EWATCH_WRITE) FD_SET(watch->fd, writeset);
+    if (watch->fd > *max_fd) *max_fd = watch->fd;
+  }
+
+  if (!get_first_expiry(&first_expiry)) return nullptr;
+
+  long long usec = time_to_expiry<std::chrono::microseconds>(first_expiry);
+  timeout->tv_sec = usec / 1000000;
+  timeout->tv_usec = usec % 1000000;
+  return timeout;
+}
+
+bool check_event_sources(fd_set *readset, fd_set *writeset) {
+  std::unique_lock<std::mutex> l(event_source_lock);
+  bool result = false;
+
+  for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+    if (watch->removed || watch->pending_events != 0 || watch->fd < 0 || watch->fd >= FD_SETSIZE)
+      continue;
+    if ((watch->events & EWATCH_READ) && FD_ISSET(watch->fd, readset))
+      watch->pending_events |= EWATCH_READ;
+    if ((watch->events & EWATCH_WRITE) && FD_ISSET(watch->fd, writeset))
+      watch->pending_events |= EWATCH_WRITE;
+    if (watch->pending_events != 0) result = true;
+  }
+
+  if (mark_expired_timers()) result = true;
+  return result;
+}
+#endif
+
+namespace {
+/* Clears the pending state of an event source when the callback is done, or has thrown an
+   exception (for example through exit_main_loop). */
+class pending_guard_t {
+ public:
+  pending_guard_t(event_source_t *_source) : source(_source) {}
+  ~pending_guard_t() {
+    std::unique_lock<std::mutex> l(event_source_lock);
+    timer_source_t *timer = dynamic_cast<timer_source_t *>(source);
+    if (timer != nullptr) {
+      if (timer->repeating) {
+        event_clock_t::time_point now = event_clock_t::now();
+        timer->expiry += timer->interval;
+        if (timer->expiry < now) timer->expiry = now + timer->interval;
+      } else {
+        timer->removed = true;
+      }
+    }
+    source->pending_events = 0;
+#ifdef HAS_EPOLL
+    fd_watch_t *watch = dynamic_cast<fd_watch_t *>(source);
+    if (watch != nullptr && !watch->removed) epoll_update_watch(watch, EPOLL_CTL_MOD);
+#endif
+  }
+
+ private:
+  event_source_t *source;
+};
+}  // namespace
+
+void dispatch_event_sources() {
+  std::vector<std::shared_ptr<event_source_t>> pending;
+  /* Set if the timeout of the input thread may change, because a timer or a watch which is
+     always ready is pending. */
+  bool timeout_changed = false;
+
+  {
+    std::unique_lock<std::mutex> l(event_source_lock);
+    for (const std::shared_ptr<fd_watch_t> &watch : fd_watches) {
+      if (watch->pending_events == 0) continue;
+      pending.push_back(watch);
+#ifdef HAS_EPOLL
+      if (watch->always_ready) timeout_changed = true;
+#endif
+    }
+    for (const std::shared_ptr<timer_source_t> &timer : timers) {
+      if (timer->pending_events != 0) {
+        pending.push_back(timer);
+        timeout_changed = true;
+      }
+    }
+  }
+
+  if (pending.empty()) return;
+
+  size_t next = 0;
+  try {
+    for (; next < pending.size(); ++next) {
+      const std::shared_ptr<event_source_t> &source = pending[next];
+      int events;
+      {
+        std::unique_lock<std::mutex> l(event_source_lock);
+        events = source->pending_events;
+        if (source->removed) {
+          source->pending_events = 0;
+          continue;
+        }
+      }
+      pending_guard_t guard(source.get());
+      if (!source->is_blocked()) source->call(events);
+    }
+  } catch (...) {
+    /* The sources after the one whose callback threw have not been dispatched. Clear their
+       pending state, such that the input thread waits for them again. */
+    {
+      std::unique_lock<std::mutex> l(event_source_lock);
+      for (++next; next < pending.size(); ++next) {
+        pending[next]->pending_events = 0;
+#ifdef HAS_EPOLL
+        fd_watch_t *watch = dynamic_cast<fd_watch_t *>(pending[next].get());
+        if (watch != nullptr && !watch->removed) epoll_update_watch(watch, EPOLL_CTL_MOD);
+#endif
+      }
+    }
+    signal_event_sources_changed();
+    throw;
+  }
+#ifdef HAS_EPOLL
+  /* Watches in the epoll set have already been re-armed, so only the timeout may need updating.
+     This includes watches which are always ready, as the input thread does not wait for them
+     while they are pending. */
+  if (timeout_changed) signal_event_sources_changed();
+#else
+  /* Make the input thread wait for the sources that are no longer pending. */
+  (void)timeout_changed;
+  signal_event_sources_changed();
+#endif
+}
+
+};  // namespace
@@ -0,0 +1,779 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <t3window/utf8.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "dialogs/dialog.h"
+#include "headless.h"
+#include "internal.h"
+#include "log.h"
+
+/* In headless mode, libt3window writes to the slave side of a pseudo terminal. The master side is
+   read by a separate thread, which feeds the output to the emulator below. To know when the
+   emulator has processed all output of a screen update, headless_update writes a private OSC
+   sequence with a sequence number to the terminal after the update, and waits until the emulator
+   has seen it. */
+
+namespace t3_widget {
+
+#define SYNC_PREFIX "t3-headless-sync;"
+
+namespace {
+
+struct cell_t {
+  std::string text;
+  t3_attr_t attrs;
+
+  cell_t() : text(" "), attrs(0) {}
+};
+
+/* Emulator for the subset of the xterm control sequences which libt3window uses. Anything not
+   understood is ignored. */
+class emulator_t {
+ public:
+  emulator_t(int _lines, int _columns) : sync_seen(0), output_size(0) {
+    resize(_lines, _columns);
+    reset();
+  }
+
+  void resize(int _lines, int _columns);
+  void process(const char *data, size_t size);
+  const cell_t &get_cell(int line, int column) const {
+    return screen[line * columns + column];
+  }
+
+  int lines, columns;
+  int cursor_line, cursor_column;
+  bool cursor_visible;
+  /* Number of the last synchronization sequence seen. */
+  unsigned long sync_seen;
+  /* Number of bytes processed, excluding synchronization sequences. */
+  unsigned long long output_size;
+  /* Replies to send back to the application, such as cursor position reports. */
+  std::string replies;
+
+ private:
+  enum state_t {
+    STATE_GROUND,
+    STATE_ESC,
+    STATE_CSI,
+    STATE_STRING,
+    STATE_STRING_ESC,
+    STATE_CHARSET
+  };
+
+  void reset();
+  void put_char(const std::string &text, int width);
+  void line_feed();
+  void scroll_up(int top, int bottom, int count);
+  void scroll_down(int top, int bottom, int count);
+  void erase(int line, int start, int end);
+  void execute_csi(char final_char);
+  void set_graphic_rendition();
+  int param(size_t idx, int default_value) const {
+    return idx < params.size() && params[idx] > 0 ? params[idx] : default_value;
+  }
+  cell_t &cell(int line, int column) { return screen[line * columns + column]; }
+
+  std::vector<cell_t> screen;
+  state_t state;
+  std::string utf8_char, string_data, csi_private;
+  std::vector<int> params;
+  t3_attr_t attrs;
+  int scroll_top, scroll_bottom;
+  int saved_line, saved_column;
+  /* Whether the cursor is past the last column, i.e. the next character wraps. */
+  bool pending_wrap;
+  /* Character sets designated as G0 and G1, and whether G1 is shifted in. */
+  bool g0_acs, g1_acs, shift_out;
+  char charset_target;
+  /* Start of the current OSC sequence in the output, used to exclude synchronization sequences
+     from output_size. */
+  size_t string_length;
+};
+
+void emulator_t::reset() {
+  state = STATE_GROUND;
+  attrs = 0;
+  cursor_line = cursor_column = 0;
+  cursor_visible = true;
+  saved_line = saved_column = 0;
+  pending_wrap = false;
+  g0_acs = g1_acs = shift_out = false;
+  charset_target = 0;
+  string_length = 0;
+}
+
+void emulator_t::resize(int _lines, int _columns) {
+  lines = _lines;
+  columns = _columns;
+  screen.assign(lines * columns, cell_t());
+  scroll_top = 0;
+  scroll_bottom = lines - 1;
+  cursor_line = std::min(cursor_line, lines - 1);
+  cursor_column = std::min(cursor_column, columns - 1);
+  pending_wrap = false;
+}
+
+/* Unicode equivalents of the DEC special graphics characters, indexed by character - 0x60. */
+static const char *const acs_map[] = {
+    "\xe2\x97\x86", "\xe2\x96\x92", "\xe2\x90\x89", "\xe2\x90\x8c", "\xe2\x90\x8d",
+    "\xe2\x90\x8a", "\xc2\xb0",     "\xc2\xb1",     "\xe2\x90\xa4", "\xe2\x90\x8b",
+    "\xe2\x94\x98", "\xe2\x94\x90", "\xe2\x94\x8c", "\xe2\x94\x94", "\xe2\x94\xbc",
+    "\xe2\x8e\xba", "\xe2\x8e\xbb", "\xe2\x94\x80", "\xe2\x8e\xbc", "\xe2\x8e\xbd",
+    "\xe2\x94\x9c", "\xe2\x94\xa4", "\xe2\x94\xb4", "\xe2\x94\xac", "\xe2\x94\x82",
+    "\xe2\x89\xa4", "\xe2\x89\xa5", "\xcf\x80",     "\xe2\x89\xa0", "\xc2\xa3",
+    "\xc2\xb7"};
+
+void emulator_t::process(const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    unsigned char c = data[i];
+    output_size++;
+
+    switch (state) {
+      case STATE_GROUND:
+        if (c == 27) {
+          state = STATE_ESC;
+        } else if (c == '\r') {
+          cursor_column = 0;
+          pending_wrap = false;
+        } else if (c == '\n' || c == 11 || c == 12) {
+          line_feed();
+        } else if (c == '\b') {
+          if (cursor_column > 0) cursor_column--;
+          pending_wrap = false;
+        } else if (c == '\t') {
+          cursor_column = std::min(columns - 1, (cursor_column / 8 + 1) * 8);
+        } else if (c == 14) {
+          shift_out = true;
+        } else if (c == 15) {
+          shift_out = false;
+        } else if (c >= 0x20 && c < 0x80) {
+          utf8_char.clear();
+          if ((shift_out ? g1_acs : g0_acs) && c >= 0x60 && c < 0x7f) {
+            attrs |= T3_ATTR_ACS;
+            put_char(acs_map[c - 0x60], 1);
+            attrs &= ~T3_ATTR_ACS;
+          } else {
+            put_char(std::string(1, c), 1);
+          }
+        } else if (c >= 0x80) {
+          if ((c & 0xc0) != 0x80) utf8_char.clear();
+          utf8_char.push_back(c);
+          unsigned char lead = utf8_char[0];
+          size_t expected_size = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+          if (utf8_char.size() >= expected_size) {
+            put_char(utf8_char, t3_utf8_wcwidth(t3_utf8_get(utf8_char.data(), nullptr)));
+            utf8_char.clear();
+          }
+        }
+        break;
+      case STATE_ESC:
+        state = STATE_GROUND;
+        switch (c) {
+          case '[':
+            state = STATE_CSI;
+            params.clear();
+            csi_private.clear();
+            break;
+          case ']':
+          case 'P':
+          case '_':
+          case '^':
+            state = STATE_STRING;
+            string_data.clear();
+            string_length = 2;
+            break;
+          case '(':
+          case ')':
+            state = STATE_CHARSET;
+            charset_target = c;
+            break;
+          case '7':
+            saved_line = cursor_line;
+            saved_column = cursor_column;
+            break;
+          case '8':
+            cursor_line = saved_line;
+            cursor_column = saved_column;
+            pending_wrap = false;
+            break;
+          case 'D':
+            line_feed();
+            break;
+          case 'E':
+            cursor_column = 0;
+            line_feed();
+            break;
+          case 'M':
+            if (cursor_line == scroll_top)
+              scroll_down(scroll_top, scroll_bottom, 1);
+            else if (cursor_line > 0)
+              cursor_line--;
+            break;
+          case 'c':
+            resize(lines, columns);
+            reset();
+            break;
+          default:
+            break;
+        }
+        break;
+      case STATE_CHARSET:
+        if (charset_target == '(')
+          g0_acs = c == '0';
+        else
+          g1_acs = c == '0';
+        state = STATE_GROUND;
+        break;
+      case STATE_CSI:
+        if (c >= '0' && c <= '9') {
+          if (params.empty()) params.push_back(0);
+          params.back() = params.back() * 10 + (c - '0');
+        } else if (c == ';') {
+          if (params.empty()) params.push_back(0);
+          params.push_back(0);
+        } else if (c >= 0x3c && c <= 0x3f) {
+          csi_private.push_back(c);
+        } else if (c >= 0x20 && c <= 0x2f) {
+          /* Intermediate bytes are not used by any sequence understood here. */
+          csi_private.push_back(c);
+        } else if (c >= 0x40 && c <= 0x7e) {
+          execute_csi(c);
+          state = STATE_GROUND;
+        } else if (c == 27) {
+          state = STATE_ESC;
+        }
+        break;
+      case STATE_STRING:
+        string_length++;
+        if (c == 7) {
+          state = STATE_GROUND;
+        } else if (c == 27) {
+          state = STATE_STRING_ESC;
+        } else {
+          string_data.push_back(c);
+        }
+        if (state == STATE_GROUND &&
+            string_data.compare(0, strlen(SYNC_PREFIX), SYNC_PREFIX) == 0) {
+          sync_seen = strtoul(string_data.c_str() + strlen(SYNC_PREFIX), nullptr, 10);
+          output_size -= string_length;
+        }
+        break;
+      case STATE_STRING_ESC:
+        /* ESC \ terminates the string. Any other sequence aborts it. */
+        if (c == '\\') {
+          state = STATE_GROUND;
+        } else {
+          state = STATE_ESC;
+          i--;
+          output_size--;
+        }
+        break;
+    }
+  }
+}
+
+void emulator_t::put_char(const std::string &text, int width) {
+  if (width < 0) width = 1;
+  if (width == 0) {
+    /* Combining character: append to the preceding cell. */
+    int column = pending_wrap ? cursor_column : cursor_column - 1;
+    if (column >= 0) cell(cursor_line, column).text.append(text);
+    return;
+  }
+
+  if (pending_wrap || cursor_column + width > columns) {
+    cursor_column = 0;
+    line_feed();
+  }
+  cell_t &target = cell(cursor_line, cursor_column);
+  target.text = text;
+  target.attrs = attrs;
+  if (width == 2 && cursor_column + 1 < columns) {
+    cell_t &second = cell(cursor_line, cursor_column + 1);
+    second.text.clear();
+    second.attrs = attrs;
+  }
+  cursor_column += width;
+  if (cursor_column >= columns) {
+    cursor_column = columns - 1;
+    pending_wrap = true;
+  }
+}
+
+void emulator_t::line_feed() {
+  pending_wrap = false;
+  if (cursor_line == scroll_bottom)
+    scroll_up(scroll_top, scroll_bottom, 1);
+  else if (cursor_line < lines - 1)
+    cursor_line++;
+}
+
+void emulator_t::scroll_up(int top, int bottom, int count) {
+  count = std::min(count, bottom - top + 1);
+  std::move(screen.begin() + (top + count) * columns, screen.begin() + (bottom + 1) * columns,
+            screen.begin() + top * columns);
+  for (int line = bottom - count + 1; line <= bottom; line++) erase(line, 0, columns);
+}
+
+void emulator_t::scroll_down(int top, int bottom, int count) {
+  count = std::min(count, bottom - top + 1);
+  std::move_backward(screen.begin() + top * columns,
+                     screen.begin() + (bottom + 1 - count) * columns,
+                     screen.begin() + (bottom + 1) * columns);
+  for (int line = top; line < top + count; line++) erase(line, 0, columns);
+}
+
+void emulator_t::erase(int line, int start, int end) {
+  for (int column = std::max(start, 0); column < std::min(end, columns); column++) {
+    cell_t &target = cell(line, column);
+    target.text = " ";
+    /* Erasing uses the background color, but no other attributes. */
+    target.attrs = attrs & T3_ATTR_BG_MASK;
+  }
+}
+
+void emulator_t::execute_csi(char final_char) {
+  if (!csi_private.empty()) {
+    if (csi_private == "?" && (final_char == 'h' || final_char == 'l')) {
+      for (size_t i = 0; i < params.size(); i++) {
+        if (params[i] == 25) cursor_visible = final_char == 'h';
+      }
+    }
+    return;
+  }
+
+  pending_wrap = false;
+  switch (final_char) {
+    case 'A':
+      cursor_line = std::max(0, cursor_line - param(0, 1));
+      break;
+    case 'B':
+    case 'e':
+      cursor_line = std::min(lines - 1, cursor_line + param(0, 1));
+      break;
+    case 'C':
+    case 'a':
+      cursor_column = std::min(columns - 1, cursor_column + param(0, 1));
+      break;
+    case 'D':
+      cursor_column = std::max(0, cursor_column - param(0, 1));
+      break;
+    case 'G':
+    case '`':
+      cursor_column = std::min(columns, param(0, 1)) - 1;
+      break;
+    case 'd':
+      cursor_line = std::min(lines, param(0, 1)) - 1;
+      break;
+    case 'H':
+    case 'f':
+      cursor_line = std::min(lines, param(0, 1)) - 1;
+      cursor_column = std::min(columns, param(1, 1)) - 1;
+      break;
+    case 'J': {
+      int mode = params.empty() ? 0 : params[0];
+      if (mode == 0) {
+        erase(cursor_line, cursor_column, columns);
+        for (int line = cursor_line + 1; line < lines; line++) erase(line, 0, columns);
+      } else if (mode == 1) {
+        for (int line = 0; line < cursor_line; line++) erase(line, 0, columns);
+        erase(cursor_line, 0, cursor_column + 1);
+      } else {
+        for (int line = 0; line < lines; line++) erase(line, 0, columns);
+      }
+      break;
+    }
+    case 'K': {
+      int mode = params.empty() ? 0 : params[0];
+      if (mode == 0)
+        erase(cursor_line, cursor_column, columns);
+      else if (mode == 1)
+        erase(cursor_line, 0, cursor_column + 1);
+      else
+        erase(cursor_line, 0, columns);
+      break;
+    }
+    case 'X':
+      erase(cursor_line, cursor_column, cursor_column + param(0, 1));
+      break;
+    case '@': {
+      int count = std::min(param(0, 1), columns - cursor_column);
+      std::vector<cell_t>::iterator line_start = screen.begin() + cursor_line * columns;
+      std::move_backward(line_start + cursor_column, line_start + columns - count,
+                         line_start + columns);
+      erase(cursor_line, cursor_column, cursor_column + count);
+      break;
+    }
+    case 'P': {
+      int count = std::min(param(0, 1), columns - cursor_column);
+      std::vector<cell_t>::iterator line_start = screen.begin() + cursor_line * columns;
+      std::move(line_start + cursor_column + count, line_start + columns,
+                line_start + cursor_column);
+      erase(cursor_line, columns - count, columns);
+      break;
+    }
+    case 'b':
+      if (cursor_column > 0) {
+        cell_t previous = cell(cursor_line, cursor_column - 1);
+        t3_attr_t saved_attrs = attrs;
+        attrs = previous.attrs;
+        for (int i = param(0, 1); i > 0; i--) put_char(previous.text, 1);
+        attrs = saved_attrs;
+      }
+      break;
+    case 'L':
+      if (cursor_line >= scroll_top && cursor_line <= scroll_bottom)
+        scroll_down(cursor_line, scroll_bottom, param(0, 1));
+      break;
+    case 'M':
+      if (cursor_line >= scroll_top && cursor_line <= scroll_bottom)
+        scroll_up(cursor_line, scroll_bottom, param(0, 1));
+      break;
+    case 'S':
+      scroll_up(scroll_top, scroll_bottom, param(0, 1));
+      break;
+    case 'T':
+      scroll_down(scroll_top, scroll_bottom, param(0, 1));
+      break;
+    case 'r':
+      scroll_top = std::min(lines, param(0, 1)) - 1;
+      scroll_bottom = std::min(lines, param(1, lines)) - 1;
+      if (scroll_bottom <= scroll_top) {
+        scroll_top = 0;
+        scroll_bottom = lines - 1;
+      }
+      cursor_line = cursor_column = 0;
+      break;
+    case 'm':
+      set_graphic_rendition();
+      break;
+    case 'n':
+      if (param(0, 0) == 6) {
+        char buffer[32];
+        sprintf(buffer, "\033[%d;%dR", cursor_line + 1, cursor_column + 1);
+        replies.append(buffer);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void emulator_t::set_graphic_rendition() {
+  if (params.empty()) params.push_back(0);
+  for (size_t i = 0; i < params.size(); i++) {
+    int value = params[i];
+    if (value == 0) {
+      attrs = 0;
+    } else if (value == 1) {
+      attrs |= T3_ATTR_BOLD;
+    } else if (value == 2) {
+      attrs |= T3_ATTR_DIM;
+    } else if (value == 4) {
+      attrs |= T3_ATTR_UNDERLINE;
+    } else if (value == 5) {
+      attrs |= T3_ATTR_BLINK;
+    } else if (value == 7) {
+      attrs |= T3_ATTR_REVERSE;
+    } else if (value == 22) {
+      attrs &= ~(T3_ATTR_BOLD | T3_ATTR_DIM);
+    } else if (value == 24) {
+      attrs &= ~T3_ATTR_UNDERLINE;
+    } else if (value == 25) {
+      attrs &= ~T3_ATTR_BLINK;
+    } else if (value == 27) {
+      attrs &= ~T3_ATTR_REVERSE;
+    } else if (value >= 30 && value <= 37) {
+      attrs = (attrs & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(value - 30);
+    } else if (value >= 90 && value <= 97) {
+      attrs = (attrs & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(value - 90 + 8);
+    } else if (value == 39) {
+      attrs = (attrs & ~T3_ATTR_FG_MASK) | T3_ATTR_FG_DEFAULT;
+    } else if (value >= 40 && value <= 47) {
+      attrs = (attrs & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(value - 40);
+    } else if (value >= 100 && value <= 107) {
+      attrs = (attrs & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(value - 100 + 8);
+    } else if (value == 49) {
+      attrs = (attrs & ~T3_ATTR_BG_MASK) | T3_ATTR_BG_DEFAULT;
+    } else if ((value == 38 || value == 48) && i + 2 < params.size() && params[i + 1] == 5) {
+      if (value == 38)
+        attrs = (attrs & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(params[i + 2]);
+      else
+        attrs = (attrs & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(params[i + 2]);
+      i += 2;
+    }
+  }
+}
+
+}  // namespace
+
+/* All state below, except the file descriptors, is protected by headless_lock. */
+static std::mutex headless_lock;
+static std::condition_variable headless_synced;
+static emulator_t *emulator;
+static unsigned long sync_requested;
+static int master_fd = -1;
+/* Number of converted input characters after which all data passed to headless_write_input has
+   been converted to keys. */
+static unsigned long long input_target;
+static int saved_stdin = -1;
+static int stop_pipe[2] = {-1, -1};
+static std::thread reader_thread;
+
+static void write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t result = write(fd, data, size);
+    if (result < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return;
+    }
+    data += result;
+    size -= result;
+  }
+}
+
+static void read_output() {
+  struct pollfd fds[2];
+  char buffer[4096];
+
+  fds[0].fd = master_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = stop_pipe[0];
+  fds[1].events = POLLIN;
+
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    if (fds[1].revents != 0) return;
+    if (fds[0].revents == 0) continue;
+
+    ssize_t result = read(master_fd, buffer, sizeof(buffer));
+    if (result < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+    if (result <= 0) return;
+
+    std::string replies;
+    {
+      std::unique_lock<std::mutex> l(headless_lock);
+      emulator->process(buffer, result);
+      replies.swap(emulator->replies);
+    }
+    headless_synced.notify_all();
+    if (!replies.empty()) write_all(master_fd, replies.data(), replies.size());
+  }
+}
+
+int open_headless_terminal(int lines, int columns) {
+  struct winsize size;
+  int slave_fd = -1;
+  const char *slave_name;
+
+  if (master_fd >= 0) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  if ((master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0) return -1;
+  if (grantpt(master_fd) < 0 || unlockpt(master_fd) < 0 ||
+      (slave_name = ptsname(master_fd)) == nullptr ||
+      (slave_fd = open(slave_name, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0)
+    goto error;
+
+  memset(&size, 0, sizeof(size));
+  size.ws_row = lines;
+  size.ws_col = columns;
+  if (ioctl(master_fd, TIOCSWINSZ, &size) < 0 || pipe(stop_pipe) < 0) goto error;
+
+  /* The input of libt3window and the input thread is always read from standard input. */
+  if ((saved_stdin = dup(0)) < 0 && errno != EBADF) goto error;
+  if (dup2(slave_fd, 0) < 0) goto error;
+
+  emulator = new emulator_t(lines, columns);
+  sync_requested = 0;
+  reader_thread = std::thread(read_output);
+  return slave_fd;
+
+error:
+  int saved_errno = errno;
+  if (slave_fd >= 0) close(slave_fd);
+  if (saved_stdin >= 0) close(saved_stdin);
+  saved_stdin = -1;
+  for (int &fd : stop_pipe) {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+  close(master_fd);
+  master_fd = -1;
+  errno = saved_errno;
+  return -1;
+}
+
+void close_headless_terminal() {
+  if (master_fd < 0) return;
+
+  write_all(stop_pipe[1], "", 1);
+  reader_thread.join();
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  stop_pipe[0] = stop_pipe[1] = -1;
+
+  if (saved_stdin >= 0) {
+    dup2(saved_stdin, 0);
+    close(saved_stdin);
+    saved_stdin = -1;
+  } else {
+    close(0);
+  }
+  close(master_fd);
+  master_fd = -1;
+  delete emulator;
+  emulator = nullptr;
+}
+
+bool is_headless() { return master_fd >= 0; }
+
+void headless_inject_key(key_t key) { inject_key(key); }
+
+void headless_inject_mouse_event(const mouse_event_t &event) { inject_mouse_event(event); }
+
+void headless_write_input(const char *data, size_t size) {
+  if (master_fd < 0) return;
+  /* Any earlier input which has not been decoded yet is still included in the target. */
+  input_target = std::max(input_target, get_input_chars_converted()) + size;
+  write_all(master_fd, data, size);
+}
+
+bool headless_wait_input(int wait_msec) {
+  if (master_fd < 0) return true;
+  return wait_input_chars_converted(
+      input_target, std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_msec));
+}
+
+int headless_update(int wait_msec) {
+  int exit_code = -1;
+  key_t key;
+
+  if (master_fd < 0) return exit_code;
+
+  try {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_msec);
+    while (read_key_until(&key, deadline)) {
+      process_input_key(key);
+      deadline = std::chrono::steady_clock::now();
+    }
+  } catch (main_loop_exit_t &e) {
+    exit_code = e.retval;
+  }
+
+  {
+    trace_scope_t trace("update_dialogs");
+    dialog_t::update_dialogs();
+  }
+  {
+    trace_scope_t trace("t3_term_update");
+    t3_term_update();
+  }
+
+  char sync_sequence[64];
+  unsigned long sync_number;
+  {
+    std::unique_lock<std::mutex> l(headless_lock);
+    sync_number = ++sync_requested;
+  }
+  sprintf(sync_sequence, "\033]" SYNC_PREFIX "%lu\007", sync_number);
+  /* Standard input is the slave side of the pseudo terminal, which libt3window writes to as
+     well. */
+  write_all(0, sync_sequence, strlen(sync_sequence));
+
+  std::unique_lock<std::mutex> l(headless_lock);
+  if (!headless_synced.wait_for(l, std::chrono::seconds(5),
+                                [sync_number] { return emulator->sync_seen >= sync_number; })) {
+    lcprintf(LOG_GENERAL, LOG_WARNING, "Timeout waiting for headless terminal output\n");
+  }
+  return exit_code;
+}
+
+void headless_resize(int lines, int columns) {
+  struct winsize size;
+
+  if (master_fd < 0) return;
+
+  memset(&size, 0, sizeof(size));
+  size.ws_row = lines;
+  size.ws_col = columns;
+  if (ioctl(master_fd, TIOCSWINSZ, &size) < 0) return;
+  {
+    std::unique_lock<std::mutex> l(headless_lock);
+    emulator->resize(lines, columns);
+  }
+  /* The program is not in the session of the pseudo terminal, so no SIGWINCH is sent. */
+  inject_key(EKEY_RESIZE);
+}
+
+std::string headless_get_line(int line) {
+  std::string result;
+  std::unique_lock<std::mutex> l(headless_lock);
+  if (emulator == nullptr || line < 0 || line >= emulator->lines) return result;
+  for (int column = 0; column < emulator->columns; column++)
+    result.append(emulator->get_cell(line, column).text);
+  return result;
+}
+
+std::string headless_get_cell(int line, int column) {
+  std::unique_lock<std::mutex> l(headless_lock);
+  if (emulator == nullptr || line < 0 || line >= emulator->lines || column < 0 ||
+      column >= emulator->columns)
+    return std::string();
+  return emulator->get_cell(line, column).text;
+}
+
+t3_attr_t headless_get_attrs(int line, int column) {
+  std::unique_lock<std::mutex> l(headless_lock);
+  if (emulator == nullptr || line < 0 || line >= emulator->lines || column < 0 ||
+      column >= emulator->columns)
+    return 0;
+  return emulator->get_cell(line, column).attrs;
+}
+
+void headless_get_cursor(int *line, int *column, bool *visible) {
+  std::unique_lock<std::mutex> l(headless_lock);
+  if (line != nullptr) *line = emulator == nullptr ? 0 : emulator->cursor_line;
+  if (column != nullptr) *column = emulator == nullptr ? 0 : emulator->cursor_column;
+  if (visible != nullptr) *visible = emulator != nullptr && emulator->cursor_visible;
+}
+
+unsigned long long headless_get_output_size() {
+  std::unique_lock<std::mutex> l(headless_lock);
+  return emulator == nullptr ? 0 : emulator->output_size;
+}
+
+};  // namespace
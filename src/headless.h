@@ -0,0 +1,99 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_HEADLESS_H
+#define T3_WIDGET_HEADLESS_H
+
+/** @file
+    Functions for running libt3widget without a terminal.
+
+    When init_parameters_t::headless is set, #init creates a pseudo terminal instead of using the
+    terminal the program runs in. Standard input is replaced by the pseudo terminal, while
+    standard output is left alone. Everything written to the pseudo terminal is interpreted by a
+    built-in emulator for the subset of the xterm control sequences used by libt3window, which
+    maintains the screen contents as a grid of cells.
+
+    The functions in this file allow driving the widgets programmatically: input is injected,
+    #headless_update handles the injected input and updates the screen, after which the screen
+    contents can be read back. This is intended for tests and benchmarks, and these functions
+    may only be called from the thread which called #init.
+*/
+
+#include <string>
+
+#include <t3widget/key.h>
+#include <t3widget/mouse.h>
+#include <t3widget/widget_api.h>
+#include <t3window/window.h>
+
+namespace t3_widget {
+
+/** Check whether libt3widget was initialized in headless mode. */
+T3_WIDGET_API bool is_headless();
+
+/** Queue a key, as if it was typed by the user. */
+T3_WIDGET_API void headless_inject_key(key_t key);
+/** Queue a mouse event.
+    Only the @c type, @c x, @c y, @c button_state and @c modifier_state members of @p event are
+    used.
+*/
+T3_WIDGET_API void headless_inject_mouse_event(const mouse_event_t &event);
+/** Write raw input to the terminal.
+    The input is decoded by the input thread, like the input from a real terminal. This allows
+    replaying recorded terminal input, including escape sequences. As decoding happens
+    asynchronously, call #headless_wait_input or pass a non-zero wait time to #headless_update
+    afterwards.
+*/
+T3_WIDGET_API void headless_write_input(const char *data, size_t size);
+/** Wait until all input written by #headless_write_input has been decoded into keys.
+    @param wait_msec The maximum time in milliseconds to wait.
+    @return @c true if all input was decoded, or @c false if the time expired first.
+
+    Input ending in an incomplete key sequence is only decoded once the key timeout expires.
+    Terminal replies, such as cursor position reports, are handled by libt3window and must not
+    be passed to #headless_write_input when using this function.
+*/
+T3_WIDGET_API bool headless_wait_input(int wait_msec);
+
+/** Handle the queued input and update the screen.
+    @param wait_msec The maximum time in milliseconds to wait for input, if none is queued.
+    @return The exit code passed to #exit_main_loop if it was called while handling the input,
+        or -1 otherwise.
+
+    When this function returns, all output has been processed by the emulator.
+*/
+T3_WIDGET_API int headless_update(int wait_msec = 0);
+
+/** Change the size of the emulated terminal.
+    The resize is handled by the next call to #headless_update.
+*/
+T3_WIDGET_API void headless_resize(int lines, int columns);
+
+/** Retrieve the text of line @p line of the screen, in UTF-8. */
+T3_WIDGET_API std::string headless_get_line(int line);
+/** Retrieve the text of the cell at @p line and @p column, in UTF-8.
+    The second cell of a double width character is empty.
+*/
+T3_WIDGET_API std::string headless_get_cell(int line, int column);
+/** Retrieve the attributes of the cell at @p line and @p column.
+    Characters drawn using the alternate character set are returned as their Unicode equivalent,
+    with the @c T3_ATTR_ACS attribute set.
+*/
+T3_WIDGET_API t3_attr_t headless_get_attrs(int line, int column);
+/** Retrieve the position of the cursor, and whether it is visible. */
+T3_WIDGET_API void headless_get_cursor(int *line, int *column, bool *visible);
+/** Retrieve the total number of bytes written to the terminal since #init. */
+T3_WIDGET_API unsigned long long headless_get_output_size();
+
+};  // namespace
+#endif
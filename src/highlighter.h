@@ -0,0 +1,54 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_HIGHLIGHTER_H
+#define T3_WIDGET_HIGHLIGHTER_H
+
+#include <t3widget/textline.h>
+#include <t3widget/widget_api.h>
+
+namespace t3_widget {
+
+/** Base class for syntax highlighters.
+
+    A highlighter is attached to a text_buffer_t using text_buffer_t::set_highlighter.
+    It is called for one line at a time, with the state at the end of the previous line,
+    and returns the state at the end of the line. The text_buffer_t stores the end state
+    of every line. After an edit, lines are only highlighted again starting from the first
+    edited line, until the end state of a line after the edits matches the stored end state.
+    Lines are highlighted lazily, up to the last line that is painted.
+
+    States are represented as non-negative integers. It is up to the highlighter to
+    define their meaning, for example by indexing a table of lexer states.
+*/
+class T3_WIDGET_API highlighter_t {
+ public:
+  virtual ~highlighter_t();
+
+  /** Get the state at the start of the text. The default returns 0. */
+  virtual int get_initial_state() const;
+
+  /** Highlight a single line.
+      @param line The line to highlight.
+      @param state The state at the end of the previous line.
+      @param runs Location to store the attributes for the line. The vector is empty on
+          entry. Runs must be added in order of increasing text_line_t::attr_run_t::end.
+          Bytes after the last run are painted using the normal attribute.
+      @return The state at the end of @p line.
+  */
+  virtual int highlight_line(const text_line_t *line, int state,
+                             text_line_t::attr_runs_t *runs) = 0;
+};
+
+};  // namespace
+#endif
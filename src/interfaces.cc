@@ -26,10 +26,12 @@ window_component_t::~window_component_t() {}
 t3_window_t *window_component_t::get_base_window() { return window; }
 
 bool container_t::set_widget_parent(window_component_t *widget) {
+  mouse_target_t::invalidate_target_cache();
   return t3_win_set_parent(widget->get_base_window(), window);
 }
 
 void container_t::unset_widget_parent(window_component_t *widget) {
+  mouse_target_t::invalidate_target_cache();
   t3_win_set_parent(widget->get_base_window(), widget_t::default_parent);
 }
 
@@ -40,7 +42,11 @@ void center_component_t::set_center_window(window_component_t *_center_window) {
 
 mouse_target_t::mouse_target_map_t mouse_target_t::targets;
 mouse_target_t *mouse_target_t::grab_target;
+container_t *mouse_target_t::grab_container;
 t3_window_t *mouse_target_t::grab_window;
+mouse_target_t::target_chain_t mouse_target_t::target_chain;
+t3_window_t *mouse_target_t::target_chain_window;
+unsigned mouse_target_t::target_chain_generation, mouse_target_t::targets_generation = 1;
 
 mouse_target_t::mouse_target_t(bool use_window) {
   if (use_window && window != nullptr) register_mouse_target(window);
@@ -48,23 +54,27 @@ mouse_target_t::mouse_target_t(bool use_window) {
 
 void mouse_target_t::register_mouse_target(t3_window_t *target) {
   if (target == nullptr)
-    lprintf("Registering mouse target for nullptr window in %s\n", typeid(*this).name());
+    lcprintf(LOG_WIDGETS, LOG_WARNING, "Registering mouse target for nullptr window in %s\n",
+             typeid(*this).name());
   else
     targets[target] = this;
+  invalidate_target_cache();
 }
 
-void mouse_target_t::unregister_mouse_target(t3_window_t *target) { targets.erase(target); }
+void mouse_target_t::unregister_mouse_target(t3_window_t *target) {
+  targets.erase(target);
+  invalidate_target_cache();
+}
 
 mouse_target_t::~mouse_target_t() {
-/* Can't use iter anymore after erasing, so we have to start our search all over
-   once we have found ourselves. */
-start_over:
-  for (mouse_target_map_t::iterator iter = targets.begin(); iter != targets.end(); iter++) {
+  for (mouse_target_map_t::iterator iter = targets.begin(); iter != targets.end();) {
     if (iter->second == this) {
-      targets.erase(iter);
-      goto start_over;
+      iter = targets.erase(iter);
+    } else {
+      ++iter;
     }
   }
+  invalidate_target_cache();
 
   if (grab_target == this) grab_target = nullptr;
 }
@@ -75,6 +85,7 @@ void mouse_target_t::grab_mouse() {
   for (const mouse_target_map_t::value_type &target : targets) {
     if (target.second == this) {
       grab_target = this;
+      grab_container = dynamic_cast<container_t *>(this);
       grab_window = target.first;
       return;
     }
@@ -85,6 +96,22 @@ void mouse_target_t::release_mouse_grab() {
   if (grab_target == this) grab_target = nullptr;
 }
 
+void mouse_target_t::invalidate_target_cache() { targets_generation++; }
+
+const mouse_target_t::target_chain_t &mouse_target_t::get_target_chain(t3_window_t *win) {
+  if (win == target_chain_window && target_chain_generation == targets_generation)
+    return target_chain;
+
+  target_chain.clear();
+  target_chain_window = win;
+  target_chain_generation = targets_generation;
+  for (; win != nullptr; win = t3_win_get_parent(win)) {
+    mouse_target_map_t::iterator iter = targets.find(win);
+    if (iter != targets.end()) target_chain.push_back(*iter);
+  }
+  return target_chain;
+}
+
 static long timediff(struct timeval a, struct timeval b) {
   long result = a.tv_sec - b.tv_sec;
   if (result > 10) return 10 * 1000000;
@@ -106,13 +133,19 @@ bool mouse_target_t::handle_mouse_event(mouse_event_t event) {
 
   bool handled = false;
   t3_window_t *win;
-  mouse_target_map_t::iterator iter;
   dialog_t *active_dialog;
+  bool new_press = event.type == EMOUSE_BUTTON_PRESS && event.previous_button_state == 0 &&
+                   (event.button_state & 7) != 0;
 
-  win = t3_win_at_location(event.y, event.x);
+  /* While a button is held down, all events except the release are reported to the window in
+     which the button was pressed. Looking up the window at the location of the event is then
+     unnecessary, which matters for the high rate of motion events during drags. */
+  if (button_down_win != nullptr && !new_press && event.type != EMOUSE_BUTTON_RELEASE)
+    win = button_down_win;
+  else
+    win = t3_win_at_location(event.y, event.x);
 
-  if (event.type == EMOUSE_BUTTON_PRESS && event.previous_button_state == 0 &&
-      (event.button_state & 7) != 0) {
+  if (new_press) {
     button_down_win = win;
     button_down_x = event.x;
     button_down_y = event.y;
@@ -154,8 +187,6 @@ bool mouse_target_t::handle_mouse_event(mouse_event_t event) {
 
     win = button_down_win;
     button_down_win = nullptr;
-  } else if (button_down_win != nullptr) {
-    win = button_down_win;
   }
 
   /* Set the window member of the event. In principle this is simply the window
@@ -166,46 +197,55 @@ bool mouse_target_t::handle_mouse_event(mouse_event_t event) {
   active_dialog = dialog_t::active_dialogs.back();
 
   // FIXME: should notify dialog of outside-dialog clicks
-  while (win != nullptr) {
-    iter = targets.find(win);
-    if (iter != targets.end()) {
-      mouse_event_t local_event = event;
-
-      if (grab_target == nullptr) {
-        if (iter->second != nullptr && !active_dialog->is_child(iter->second)) return handled;
-      } else {
-        container_t *grab_container = dynamic_cast<container_t *>(grab_target);
-        if (((grab_container != nullptr) &&
-             (iter->second == nullptr || (!grab_container->is_child(iter->second) &&
-                                          (window_component_t *)grab_container != iter->second))) ||
-            (grab_container == nullptr && grab_target != iter->second)) {
-          mouse_event_t grab_event = local_event;
-          grab_event.type |= EMOUSE_OUTSIDE_GRAB;
-          grab_event.x -= t3_win_get_abs_x(grab_window);
-          grab_event.y -= t3_win_get_abs_y(grab_window);
-          if (handled | grab_target->process_mouse_event(grab_event)) return true;
-        }
+  unsigned generation = targets_generation;
+  const target_chain_t *chain = &get_target_chain(win);
+  for (size_t i = 0; i < chain->size();) {
+    t3_window_t *target_win = (*chain)[i].first;
+    mouse_target_t *target = (*chain)[i].second;
+    mouse_event_t local_event = event;
+
+    if (grab_target == nullptr) {
+      if (target != nullptr && !active_dialog->is_child(target)) return handled;
+    } else {
+      if (((grab_container != nullptr) &&
+           (target == nullptr || (!grab_container->is_child(target) &&
+                                  (window_component_t *)grab_container != target))) ||
+          (grab_container == nullptr && grab_target != target)) {
+        mouse_event_t grab_event = local_event;
+        grab_event.type |= EMOUSE_OUTSIDE_GRAB;
+        grab_event.x -= t3_win_get_abs_x(grab_window);
+        grab_event.y -= t3_win_get_abs_y(grab_window);
+        if (handled | grab_target->process_mouse_event(grab_event)) return true;
       }
+    }
 
-      local_event.x -= t3_win_get_abs_x(win);
-      local_event.y -= t3_win_get_abs_y(win);
-      if (iter->second->process_mouse_event(local_event)) {
-        /* If the active dialog has not changed by processing the event,
-           and the event is a button press, we should focus the widget that
-           received the event. */
-        if (!handled && iter->second != nullptr &&
-            active_dialog == dialog_t::active_dialogs.back() && event.type == EMOUSE_BUTTON_PRESS &&
-            event.previous_button_state == 0 && (event.button_state & EMOUSE_ALL_BUTTONS) != 0)
-          active_dialog->set_child_focus(iter->second);
-        handled = true;
-        /* Stop handling if the dialog is no longer active. This happens for
-           for example when the active dialog is closed by the button, or worse,
-           deleted. In the latter case, trying to go up the hierarchy will
-           access free'd memory, which may cause a segfault. */
-        if (active_dialog != dialog_t::active_dialogs.back()) return handled;
-      }
+    local_event.x -= t3_win_get_abs_x(target_win);
+    local_event.y -= t3_win_get_abs_y(target_win);
+    if (target->process_mouse_event(local_event)) {
+      /* If the active dialog has not changed by processing the event,
+         and the event is a button press, we should focus the widget that
+         received the event. */
+      if (!handled && target != nullptr && active_dialog == dialog_t::active_dialogs.back() &&
+          event.type == EMOUSE_BUTTON_PRESS && event.previous_button_state == 0 &&
+          (event.button_state & EMOUSE_ALL_BUTTONS) != 0)
+        active_dialog->set_child_focus(target);
+      handled = true;
+      /* Stop handling if the dialog is no longer active. This happens for
+         for example when the active dialog is closed by the button, or worse,
+         deleted. In the latter case, trying to go up the hierarchy will
+         access free'd memory, which may cause a segfault. */
+      if (active_dialog != dialog_t::active_dialogs.back()) return handled;
+    }
+
+    if (generation != targets_generation) {
+      /* Processing the event changed the registered targets or the window hierarchy, so the
+         remainder of the chain must be determined again. */
+      generation = targets_generation;
+      chain = &get_target_chain(t3_win_get_parent(target_win));
+      i = 0;
+    } else {
+      ++i;
     }
-    win = t3_win_get_parent(win);
   }
   return handled;
 }
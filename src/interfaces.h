@@ -15,7 +15,9 @@
 #define T3_WIDGET_INTERFACES_H
 
 #include <list>
-#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <t3window/window.h>
 
 #include <t3widget/key.h>
@@ -119,13 +121,24 @@ class T3_WIDGET_API center_component_t : protected virtual window_component_t {
 };
 
 class T3_WIDGET_API mouse_target_t : protected virtual window_component_t {
-  typedef std::map<t3_window_t *, mouse_target_t *> mouse_target_map_t;
+  typedef std::unordered_map<t3_window_t *, mouse_target_t *> mouse_target_map_t;
+  typedef std::vector<std::pair<t3_window_t *, mouse_target_t *>> target_chain_t;
 
  private:
   static mouse_target_map_t targets;
   static mouse_target_t *grab_target;
+  /* The result of dynamic_cast<container_t *>(grab_target), determined when grabbing. */
+  static container_t *grab_container;
   static t3_window_t *grab_window;
 
+  /* The registered targets for a window and its ancestors, closest first. This is reused as long
+     as events are delivered to the same window and targets_generation does not change. */
+  static target_chain_t target_chain;
+  static t3_window_t *target_chain_window;
+  static unsigned target_chain_generation, targets_generation;
+
+  static const target_chain_t &get_target_chain(t3_window_t *win);
+
  protected:
   mouse_target_t(bool use_window = true);
 
@@ -154,6 +167,13 @@ class T3_WIDGET_API mouse_target_t : protected virtual window_component_t {
   void release_mouse_grab();
 
   static bool handle_mouse_event(mouse_event_t event);
+
+  /** Invalidate cached information about the mouse targets.
+
+      Must be called whenever the parent of a window changes, as that changes which mouse targets
+      receive the events for the window.
+  */
+  static void invalidate_target_cache();
 };
 
 /** Base class for widgets that need handle user text and draw differently based on the
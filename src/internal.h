@@ -19,8 +19,12 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <t3widget/key.h>
+#include <t3widget/keybuffer.h>
 
 #ifdef HAS_SELECT_H
 #include <sys/select.h>
@@ -104,13 +108,22 @@ T3_WIDGET_LOCAL void reinit_keys();
 /** Insert a key to the queue, marked to ensure it is not interpreted by any widget except text
  * widgets. */
 T3_WIDGET_LOCAL void insert_protected_key(t3_widget::key_t key);
+/** Retrieve a key from the input queue, waiting at most until @p deadline.
+    @return @c true if a key was stored in @p key, @c false if the deadline passed first. */
+T3_WIDGET_LOCAL bool read_key_until(t3_widget::key_t *key,
+                                    std::chrono::steady_clock::time_point deadline);
 /** Read chars into buffer for processing. */
 T3_WIDGET_LOCAL bool read_keychar(int timeout);
+/** Get the number of characters read from the terminal and converted to keys so far. */
+T3_WIDGET_LOCAL unsigned long long get_input_chars_converted();
+/** Wait until @p count characters read from the terminal have been converted to keys.
+    @return @c false if @p deadline passed first. */
+T3_WIDGET_LOCAL bool wait_input_chars_converted(unsigned long long count,
+                                                std::chrono::steady_clock::time_point deadline);
 
 /* char_buffer for key and mouse handling. Has to be shared between key.cc and
    mouse.cc because of XTerm in-band mouse reporting. */
-extern char char_buffer[128];
-extern int char_buffer_fill;
+extern input_buffer_t<char, 128> char_buffer;
 
 /** Initialize the mouse handling code. */
 T3_WIDGET_LOCAL void init_mouse_reporting(bool xterm_mouse);
@@ -126,17 +139,120 @@ T3_WIDGET_LOCAL bool decode_xterm_mouse();
 T3_WIDGET_LOCAL bool decode_xterm_mouse_sgr_urxvt(const key_t *data, size_t len);
 /** Report whether XTerm mouse reporting is active. */
 T3_WIDGET_LOCAL bool use_xterm_mouse_reporting();
+#ifdef HAS_EPOLL
+/** Get the mouse event fd, or -1 if there is none. */
+T3_WIDGET_LOCAL int get_mouse_fd();
+/** Process the available data on the mouse event fd. */
+T3_WIDGET_LOCAL bool process_mouse_fd();
+#else
 /** Set bit(s) for mouse event fd. */
 T3_WIDGET_LOCAL void fd_set_mouse_fd(fd_set *readset, int *max_fd);
 /** Check the mouse event fd for events, if appropriate bits in @p readset indicate available data.
  */
 T3_WIDGET_LOCAL bool check_mouse_fd(fd_set *readset);
+#endif
+
+/** Notify the input thread that the set of event sources to wait for has changed. */
+T3_WIDGET_LOCAL void signal_event_sources_changed();
+#ifdef HAS_EPOLL
+/** First identifier used for event sources in the epoll set. Lower values are used by key.cc. */
+#define EPOLL_FIRST_EVENT_SOURCE_ID 16
+/** Add the watched file descriptors to @p epoll_fd, and add any watches created later as well. */
+T3_WIDGET_LOCAL void init_event_sources(int epoll_fd);
+/** Stop using the epoll set passed to #init_event_sources. */
+T3_WIDGET_LOCAL void cleanup_event_sources();
+/** Get the time in milliseconds until the first timer expires, or -1 if there are no timers. */
+T3_WIDGET_LOCAL int get_event_sources_timeout();
+/** Mark the event source with identifier @p id as pending, based on the epoll @p events.
+    @return @c true if the event source was newly marked as pending.
+*/
+T3_WIDGET_LOCAL bool check_event_source(uint64_t id, uint32_t events);
+/** Mark expired timers, and watches for file descriptors which can not be added to the epoll set,
+    as pending.
+    @return @c true if any event source was newly marked as pending.
+*/
+T3_WIDGET_LOCAL bool check_event_source_timers();
+#else
+/** Set bits for the file descriptors of the registered event sources.
+    @return @p timeout, filled with the time until the first timer expires, or @c nullptr if
+        there are no active timers.
+*/
+T3_WIDGET_LOCAL struct timeval *fd_set_event_sources(fd_set *readset, fd_set *writeset, int *max_fd,
+                                                     struct timeval *timeout);
+/** Mark event sources which are ready according to @p readset and @p writeset, or have expired, as
+    pending.
+    @return @c true if any event source was newly marked as pending.
+*/
+T3_WIDGET_LOCAL bool check_event_sources(fd_set *readset, fd_set *writeset);
+#endif
+/** Run the callbacks of all pending event sources. Must be called from the main loop. */
+T3_WIDGET_LOCAL void dispatch_event_sources();
+
+/** Exception used by #exit_main_loop to unwind to #main_loop. */
+struct T3_WIDGET_LOCAL main_loop_exit_t {
+  int retval;
+  main_loop_exit_t(int _retval) : retval(_retval) {}
+};
+
+/** Handle a single key or mouse event read from the input queue. */
+T3_WIDGET_LOCAL void process_input_key(t3_widget::key_t key);
+/** Insert a key in the input queue, without marking it as protected. */
+T3_WIDGET_LOCAL void inject_key(t3_widget::key_t key);
+/** Insert a mouse event in the input queue. */
+T3_WIDGET_LOCAL void inject_mouse_event(mouse_event_t event);
+
+/** Create the pseudo terminal used in headless mode, and replace standard input with it.
+    @return The file descriptor to pass to @c t3_term_init, or -1 on failure, with @c errno set.
+*/
+T3_WIDGET_LOCAL int open_headless_terminal(int lines, int columns);
+/** Close the pseudo terminal used in headless mode, if it was opened. */
+T3_WIDGET_LOCAL void close_headless_terminal();
 
 enum { CLASS_WHITESPACE, CLASS_ALNUM, CLASS_GRAPH, CLASS_OTHER };
 
 /** Get the character class associated with the character at a specific position in a string. */
 T3_WIDGET_LOCAL int get_class(const std::string *str, int pos);
 
+/** Get the number of bytes of heap memory used by @p str, in addition to the object itself.
+
+    Short strings are stored inside the object, in which case this returns 0.
+*/
+T3_WIDGET_LOCAL size_t string_heap_usage(const std::string &str);
+
+/** Stores the time elapsed between its construction and destruction in a variable. */
+class T3_WIDGET_LOCAL scoped_timer_t {
+ public:
+  scoped_timer_t(std::chrono::nanoseconds *_result)
+      : result(_result), start(std::chrono::steady_clock::now()) {}
+  ~scoped_timer_t() { *result = std::chrono::steady_clock::now() - start; }
+
+ private:
+  std::chrono::nanoseconds *result;
+  std::chrono::steady_clock::time_point start;
+};
+
+T3_WIDGET_LOCAL extern std::atomic<bool> trace_enabled;
+/** Record a trace event. Use trace_scope_t instead of calling this directly. */
+T3_WIDGET_LOCAL void trace_record(const char *name, std::chrono::steady_clock::time_point start,
+                                  std::chrono::steady_clock::time_point end);
+
+/** Records a trace event for the time between its construction and destruction, if tracing is
+    enabled. @p name must be a string literal. */
+class T3_WIDGET_LOCAL trace_scope_t {
+ public:
+  trace_scope_t(const char *_name)
+      : name(trace_enabled.load(std::memory_order_relaxed) ? _name : nullptr) {
+    if (name != nullptr) start = std::chrono::steady_clock::now();
+  }
+  ~trace_scope_t() {
+    if (name != nullptr) trace_record(name, start, std::chrono::steady_clock::now());
+  }
+
+ private:
+  const char *name;
+  std::chrono::steady_clock::time_point start;
+};
+
 template <typename C>
 void remove_element(C &container, typename C::value_type value) {
   container.erase(std::remove(container.begin(), container.end(), value), container.end());
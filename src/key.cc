@@ -11,13 +11,22 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
 #include <cerrno>
 #include <climits>
+#include <condition_variable>
 #include <csignal>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <transcript/transcript.h>
+#ifdef HAS_EPOLL
+#include <atomic>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 #include <t3key/key.h>
 
@@ -32,11 +41,21 @@ namespace t3_widget {
 
 #define MAX_SEQUENCE 100
 
+#ifdef HAS_EPOLL
+/* Identifiers stored in the epoll_event data of the file descriptors waited for by read_keys. */
+enum {
+  EPOLL_STDIN_ID,
+  EPOLL_WAKEUP_ID,
+  EPOLL_MOUSE_ID,
+};
+#else
 enum {
   WINCH_SIGNAL,
   QUIT_SIGNAL,
   EXIT_MAIN_LOOP_SIGNAL,
+  EVENT_SOURCES_SIGNAL,
 };
+#endif
 
 struct key_string_t {
   const char *string;
@@ -49,6 +68,20 @@ struct mapping_t {
   key_t key;
 };
 
+/* Node in the trie of known escape sequences. The root node represents the leading escape
+   character. The outgoing edges of a node are stored consecutively in key_trie_edges, sorted by
+   character, so the next node can be found with a binary search. */
+struct key_trie_node_t {
+  key_t key;
+  bool is_key;
+  int first_edge, edge_count;
+};
+
+struct key_trie_edge_t {
+  unsigned char c;
+  int node;
+};
+
 struct key_sequence_t {
   key_t data[MAX_SEQUENCE];
   size_t idx;
@@ -95,55 +128,145 @@ static const kp_mapping_t kp_mappings[] = {
     {EKEY_KP_NL, EKEY_NL},     {EKEY_KP_DIV, '/'},          {EKEY_KP_MUL, '*'},
     {EKEY_KP_PLUS, '+'},       {EKEY_KP_MINUS, '-'}};
 
-static mapping_t *map;
-static int map_count;
+static std::vector<key_trie_node_t> key_trie_nodes;
+static std::vector<key_trie_edge_t> key_trie_edges;
 static key_t map_single[128];
 
 static const char *leave, *enter;
 
 static const t3_key_node_t *keymap;
+#ifdef HAS_EPOLL
+static int epoll_fd = -1;
+/* Set when stdin can not be added to the epoll set, which is the case for regular files such as
+   /dev/null. Like select does, stdin is then considered to be always readable. */
+static bool stdin_always_ready;
+/* eventfd used to wake up the input thread. The reason for the wake-up is communicated through
+   the flags below. */
+static int wakeup_fd = -1;
+static std::atomic<bool> quit_requested;
+static volatile sig_atomic_t winch_received;
+/* Exit code passed to async_safe_exit_main_loop plus one, or zero if not requested. */
+static volatile sig_atomic_t exit_main_loop_requested;
+#else
 static int signal_pipe[2] = {-1, -1};
+#endif
 
 static key_buffer_t key_buffer;
 static std::thread read_key_thread;
 
-char char_buffer[128];
-int char_buffer_fill;
-static uint32_t unicode_buffer[16];
-static int unicode_buffer_fill;
+input_buffer_t<char, 128> char_buffer;
+static input_buffer_t<uint32_t, 128> unicode_buffer;
 static transcript_t *conversion_handle;
+/* Set when the terminal codeset is UTF-8, in which case convert_utf8 is used instead of
+   conversion_handle. */
+static bool utf8_input;
+
+/* Number of characters read from the terminal by the input thread, and the number of those
+   that have been converted to keys. Used by headless mode to wait until input is handled. */
+static unsigned long long input_chars_read;
+static unsigned long long input_chars_converted;
+static std::mutex input_converted_lock;
+static std::condition_variable input_converted_cond;
 
 static std::mutex key_timeout_lock;
 static int key_timeout = -1;
 static bool drop_single_esc = true;
 
-/* Used in decode_sequence and comparison routine to communicate whether the current
-   sequence is a prefix of any known sequence. */
-static bool is_prefix;
 static bool in_bracketed_paste;
 
 static key_t decode_sequence(bool outer);
 static key_t bracketed_paste_decode();
 static void stop_keys();
 
+/* Length of a UTF-8 sequence, indexed by the upper five bits of the first byte. Zero for
+   continuation bytes. */
+static const uint8_t utf8_length[32] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                                        0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 3, 3, 4, 0};
+static const uint32_t utf8_min_value[5] = {0, 0, 0x80, 0x800, 0x10000};
+
+/* Convert as much of char_buffer as possible from UTF-8 to UTF-32, without going through
+   libtranscript.
+
+   Conversion stops after an escape character, because decode_sequence consumes the bytes
+   following it from char_buffer directly. Invalid sequences are skipped, like the fallback
+   handling for libtranscript does. */
+static void convert_utf8() {
+  const unsigned char *ptr = reinterpret_cast<const unsigned char *>(char_buffer.data());
+  const unsigned char *end = ptr + char_buffer.size();
+  uint32_t *unicode_buffer_start = unicode_buffer.tail();
+  uint32_t *unicode_ptr = unicode_buffer_start;
+  uint32_t *unicode_end = unicode_buffer_start + unicode_buffer.tail_space();
+
+  while (ptr < end && unicode_ptr < unicode_end) {
+    /* Copy runs of plain ASCII characters eight bytes at a time. The second test checks that
+       none of the bytes is an escape character, using the "has zero byte" trick. */
+    while (end - ptr >= 8 && unicode_end - unicode_ptr >= 8) {
+      uint64_t word;
+      memcpy(&word, ptr, sizeof(word));
+      uint64_t escapes = word ^ UINT64_C(0x1b1b1b1b1b1b1b1b);
+      if ((word & UINT64_C(0x8080808080808080)) != 0 ||
+          ((escapes - UINT64_C(0x0101010101010101)) & ~escapes & UINT64_C(0x8080808080808080)) != 0)
+        break;
+      for (int i = 0; i < 8; ++i) unicode_ptr[i] = ptr[i];
+      ptr += 8;
+      unicode_ptr += 8;
+    }
+    if (ptr == end || unicode_ptr == unicode_end) break;
+
+    uint32_t c = *ptr;
+    int length = utf8_length[c >> 3];
+    if (length == 1) {
+      ++ptr;
+      *unicode_ptr++ = c;
+      if (c == EKEY_ESC) break;
+      continue;
+    }
+    if (length == 0) {
+      ++ptr;
+      continue;
+    }
+
+    c &= 0x7f >> length;
+    int i;
+    for (i = 1; i < length && ptr + i < end && (ptr[i] & 0xc0) == 0x80; ++i) {
+      c = (c << 6) | (ptr[i] & 0x3f);
+    }
+    if (i < length) {
+      /* Incomplete sequence at the end of the buffer: wait for more input. */
+      if (ptr + i == end) break;
+      ptr += i;
+      continue;
+    }
+    ptr += length;
+    if (c < utf8_min_value[length] || c > 0x10ffff || (c >= 0xd800 && c < 0xe000)) continue;
+    *unicode_ptr++ = c;
+  }
+
+  char_buffer.erase_front(reinterpret_cast<const char *>(ptr) - char_buffer.data());
+  unicode_buffer.commit(unicode_ptr - unicode_buffer_start);
+}
+
 static void convert_next_key() {
-  const char *char_buffer_ptr;
-  uint32_t *unicode_buffer_ptr;
+  if (utf8_input) {
+    convert_utf8();
+    return;
+  }
 
-  char_buffer_ptr = char_buffer;
-  unicode_buffer_ptr = unicode_buffer;
+  const char *char_buffer_ptr = char_buffer.data();
+  const char *char_buffer_end = char_buffer_ptr + char_buffer.size();
+  uint32_t *unicode_buffer_start = unicode_buffer.tail();
+  uint32_t *unicode_buffer_ptr = unicode_buffer_start;
 
   while (true) {
-    switch (transcript_to_unicode(conversion_handle, &char_buffer_ptr,
-                                  char_buffer + char_buffer_fill, (char **)&unicode_buffer_ptr,
-                                  ((const char *)unicode_buffer) + sizeof(unicode_buffer),
-                                  TRANSCRIPT_ALLOW_FALLBACK | TRANSCRIPT_SINGLE_CONVERSION)) {
+    switch (transcript_to_unicode(
+        conversion_handle, &char_buffer_ptr, char_buffer_end, (char **)&unicode_buffer_ptr,
+        (const char *)(unicode_buffer_start + unicode_buffer.tail_space()),
+        TRANSCRIPT_ALLOW_FALLBACK | TRANSCRIPT_SINGLE_CONVERSION)) {
       case TRANSCRIPT_SUCCESS:
       case TRANSCRIPT_NO_SPACE:
       case TRANSCRIPT_INCOMPLETE:
-        char_buffer_fill -= char_buffer_ptr - char_buffer;
-        if (char_buffer_fill != 0) memmove(char_buffer, char_buffer_ptr, char_buffer_fill);
-        unicode_buffer_fill = unicode_buffer_ptr - unicode_buffer;
+        char_buffer.erase_front(char_buffer_ptr - char_buffer.data());
+        unicode_buffer.commit(unicode_buffer_ptr - unicode_buffer_start);
         return;
 
       case TRANSCRIPT_FALLBACK:  // NOTE: we allow fallbacks, so this should not even occur!!!
@@ -153,8 +276,7 @@ static void convert_next_key() {
       case TRANSCRIPT_ILLEGAL_END:
       case TRANSCRIPT_INTERNAL_ERROR:
       case TRANSCRIPT_PRIVATE_USE:
-        transcript_to_unicode_skip(conversion_handle, &char_buffer_ptr,
-                                   char_buffer + char_buffer_fill);
+        transcript_to_unicode_skip(conversion_handle, &char_buffer_ptr, char_buffer_end);
         break;
       default:
         // This shouldn't happen, and we can't really do anything with this.
@@ -164,42 +286,22 @@ static void convert_next_key() {
 }
 
 static key_t get_next_converted_key() {
-  if (unicode_buffer_fill == 0) convert_next_key();
+  if (unicode_buffer.empty()) convert_next_key();
 
-  if (unicode_buffer_fill > 0) {
-    key_t c = unicode_buffer[0];
-    unicode_buffer_fill--;
-    memmove(unicode_buffer, unicode_buffer + 1, sizeof(unicode_buffer[0]) * unicode_buffer_fill);
-    return c;
-  }
+  if (!unicode_buffer.empty()) return unicode_buffer.pop_front();
   return -1;
 }
 
-static void unget_key(key_t c) {
-  memmove(unicode_buffer + 1, unicode_buffer, sizeof(unicode_buffer[0]) * unicode_buffer_fill);
-  unicode_buffer[0] = c;
-  unicode_buffer_fill++;
-}
+static void unget_key(key_t c) { unicode_buffer.push_front(c); }
 
 static int get_next_keychar() {
-  if (char_buffer_fill > 0) {
-    int c = char_buffer[0];
-    char_buffer_fill--;
-    memmove(char_buffer, char_buffer + 1, char_buffer_fill);
-    return (unsigned char)c;
-  }
+  if (!char_buffer.empty()) return (unsigned char)char_buffer.pop_front();
   return -1;
 }
 
-static void unget_keychar(int c) {
-  // Prevent buffer overflow. This simply drops the oldest character off the buffer.
-  if (char_buffer_fill >= ARRAY_SIZE(char_buffer)) {
-    char_buffer_fill = ARRAY_SIZE(char_buffer) - 1;
-  }
-  memmove(char_buffer + 1, char_buffer, sizeof(char_buffer[0]) * char_buffer_fill);
-  char_buffer[0] = c;
-  char_buffer_fill++;
-}
+/* Prevent buffer overflow. If the buffer is full, this simply drops the last character off the
+   buffer. */
+static void unget_keychar(int c) { char_buffer.push_front(c); }
 
 bool read_keychar(int timeout) {
   key_t c;
@@ -213,34 +315,136 @@ bool read_keychar(int timeout) {
                                                            0, &transcript_error)) != nullptr) {
       transcript_close_converter(conversion_handle);
       conversion_handle = new_conversion_handle;
+      utf8_input = transcript_equal(t3_term_get_codeset(), "UTF-8");
     } else {
-      lprintf("Error opening new convertor '%s': %s\n", t3_term_get_codeset(),
-              transcript_strerror(transcript_error));
+      lcprintf(LOG_INPUT, LOG_ERROR, "Error opening new convertor '%s': %s\n",
+               t3_term_get_codeset(), transcript_strerror(transcript_error));
     }
-    lprintf("New codeset: %s\n", t3_term_get_codeset());
+    lcprintf(LOG_INPUT, LOG_INFO, "New codeset: %s\n", t3_term_get_codeset());
     key_buffer.push_back_unique(EKEY_UPDATE_TERMINAL);
   }
 
   if (c < T3_WARN_MIN) return false;
 
-  char_buffer[char_buffer_fill++] = (char)c;
+  char_buffer.push_back((char)c);
+  input_chars_read++;
   return true;
 }
 
+/* Wait for input, and then read all characters that are available without waiting. Reading
+   everything at once allows convert_utf8 to handle runs of characters, instead of one byte per
+   call. */
+static void read_available_keychars() {
+  if (!read_keychar(-1)) return;
+  while (!char_buffer.full() && read_keychar(0)) {
+  }
+}
+
+/* Convert the characters read so far into keys, and add them to the key buffer. */
+static void queue_converted_keys() {
+  key_t c;
+
+  while ((c = get_next_converted_key()) >= 0) {
+    if (c == EKEY_ESC) {
+      key_t modifiers = t3_term_get_modifiers_hack();
+
+      key_timeout_lock.lock();
+      if (in_bracketed_paste) {
+        c = bracketed_paste_decode();
+      } else {
+        c = decode_sequence(true);
+      }
+      key_timeout_lock.unlock();
+      if (c < 0)
+        continue;
+      else if (drop_single_esc && c == (EKEY_ESC | EKEY_META))
+        c = EKEY_ESC;
+      else if ((c & EKEY_KEY_MASK) < 128 && map_single[c & EKEY_KEY_MASK] != 0)
+        c = (c & ~EKEY_KEY_MASK) | map_single[c & EKEY_KEY_MASK];
+
+      if (c == '\t' || (c >= EKEY_FIRST_SPECIAL && c < 0x111000 && c != EKEY_NL))
+        c |= modifiers * EKEY_CTRL;
+    } else if (!in_bracketed_paste && c > 0 && c < 128 && map_single[c] != 0) {
+      c = map_single[c];
+    }
+    if (c >= 0) {
+      key_buffer.push_back(in_bracketed_paste ? EKEY_PROTECT | c : c);
+    }
+  }
+
+  /* Only the characters of incomplete sequences remain in char_buffer. */
+  std::unique_lock<std::mutex> l(input_converted_lock);
+  input_chars_converted = input_chars_read - char_buffer.size();
+  input_converted_cond.notify_all();
+}
+
+#ifdef HAS_EPOLL
+static void read_keys() {
+  struct epoll_event events[16];
+  int count, i;
+  bool stdin_ready, event_source_ready;
+
+  while (true) {
+    count = epoll_wait(epoll_fd, events, ARRAY_SIZE(events),
+                       stdin_always_ready ? 0 : get_event_sources_timeout());
+    if (count < 0) continue;
+
+    stdin_ready = stdin_always_ready;
+    event_source_ready = false;
+    for (i = 0; i < count; i++) {
+      switch (events[i].data.u64) {
+        case EPOLL_STDIN_ID:
+          stdin_ready = true;
+          break;
+        case EPOLL_WAKEUP_ID: {
+          uint64_t value;
+          nosig_read(wakeup_fd, reinterpret_cast<char *>(&value), sizeof(value));
+          /* Exit thread */
+          if (quit_requested) return;
+          if (winch_received) {
+            winch_received = 0;
+            key_buffer.push_back_unique(EKEY_RESIZE);
+          }
+          if (exit_main_loop_requested) {
+            key_buffer.push_back_unique(EKEY_EXIT_MAIN_LOOP + exit_main_loop_requested - 1);
+            exit_main_loop_requested = 0;
+          }
+          break;
+        }
+        case EPOLL_MOUSE_ID:
+          if (process_mouse_fd()) key_buffer.push_back(EKEY_MOUSE_EVENT);
+          break;
+        default:
+          if (check_event_source(events[i].data.u64, events[i].events)) event_source_ready = true;
+          break;
+      }
+    }
+
+    if (check_event_source_timers()) event_source_ready = true;
+    if (event_source_ready) key_buffer.push_back_unique(EKEY_EVENT_SOURCE);
+
+    if (stdin_ready) read_available_keychars();
+
+    queue_converted_keys();
+  }
+}
+#else
 static void read_keys() {
   int retval;
-  key_t c;
-  fd_set readset;
+  fd_set readset, writeset;
+  struct timeval timeout_storage, *timeout;
   int max_fd;
 
   while (true) {
     FD_ZERO(&readset);
+    FD_ZERO(&writeset);
     FD_SET(0, &readset);
     FD_SET(signal_pipe[0], &readset);
     max_fd = signal_pipe[0];
     fd_set_mouse_fd(&readset, &max_fd);
+    timeout = fd_set_event_sources(&readset, &writeset, &max_fd, &timeout_storage);
 
-    retval = select(max_fd + 1, &readset, nullptr, nullptr, nullptr);
+    retval = select(max_fd + 1, &readset, &writeset, nullptr, timeout);
 
     if (retval < 0) continue;
 
@@ -263,6 +467,9 @@ static void read_keys() {
           key_buffer.push_back_unique(EKEY_EXIT_MAIN_LOOP + value);
           break;
         }
+        case EVENT_SOURCES_SIGNAL:
+          /* Only needed to rebuild the sets of file descriptors to wait for. */
+          break;
         default:
           // This should be impossible, so just ignore
           continue;
@@ -271,62 +478,41 @@ static void read_keys() {
 
     if (check_mouse_fd(&readset)) key_buffer.push_back(EKEY_MOUSE_EVENT);
 
-    if (FD_ISSET(0, &readset)) read_keychar(-1);
+    if (check_event_sources(&readset, &writeset)) key_buffer.push_back_unique(EKEY_EVENT_SOURCE);
 
-    while ((c = get_next_converted_key()) >= 0) {
-      if (c == EKEY_ESC) {
-        key_t modifiers = t3_term_get_modifiers_hack();
+    if (FD_ISSET(0, &readset)) read_available_keychars();
 
-        key_timeout_lock.lock();
-        if (in_bracketed_paste) {
-          c = bracketed_paste_decode();
-        } else {
-          c = decode_sequence(true);
-        }
-        key_timeout_lock.unlock();
-        if (c < 0)
-          continue;
-        else if (drop_single_esc && c == (EKEY_ESC | EKEY_META))
-          c = EKEY_ESC;
-        else if ((c & EKEY_KEY_MASK) < 128 && map_single[c & EKEY_KEY_MASK] != 0)
-          c = (c & ~EKEY_KEY_MASK) | map_single[c & EKEY_KEY_MASK];
-
-        if (c == '\t' || (c >= EKEY_FIRST_SPECIAL && c < 0x111000 && c != EKEY_NL))
-          c |= modifiers * EKEY_CTRL;
-      } else if (!in_bracketed_paste && c > 0 && c < 128 && map_single[c] != 0) {
-        c = map_single[c];
-      }
-      if (c >= 0) {
-        key_buffer.push_back(in_bracketed_paste ? EKEY_PROTECT | c : c);
-      }
-    }
+    queue_converted_keys();
   }
 }
+#endif
 
 key_t read_key() { return key_buffer.pop_front(); }
 
-static int compare_sequence_with_mapping(const void *key, const void *mapping) {
-  const key_sequence_t *_key;
-  const mapping_t *_mapping;
-  size_t i;
-
-  _key = (const key_sequence_t *)key;
-  _mapping = (const mapping_t *)mapping;
+unsigned long long get_input_chars_converted() {
+  std::unique_lock<std::mutex> l(input_converted_lock);
+  return input_chars_converted;
+}
 
-  for (i = 0; i < _key->idx && i < _mapping->string_length; i++) {
-    if (_key->data[i] != _mapping->string[i]) {
-      if ((char)_key->data[i] < _mapping->string[i]) return -1;
-      return 1;
-    }
-  }
+bool wait_input_chars_converted(unsigned long long count,
+                                std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> l(input_converted_lock);
+  return input_converted_cond.wait_until(l, deadline,
+                                         [count] { return input_chars_converted >= count; });
+}
 
-  if (i < _mapping->string_length) {
-    is_prefix = true;
-    return -1;
-  }
+bool read_key_until(key_t *key, std::chrono::steady_clock::time_point deadline) {
+  return key_buffer.pop_front_until(key, deadline);
+}
 
-  if (i < _key->idx) return 1;
-  return 0;
+/* Follow the edge labeled @p c from trie node @p node. Returns -1 if there is no such edge. */
+static int key_trie_step(int node, int c) {
+  const key_trie_node_t &trie_node = key_trie_nodes[node];
+  const key_trie_edge_t *begin = key_trie_edges.data() + trie_node.first_edge;
+  const key_trie_edge_t *end = begin + trie_node.edge_count;
+  const key_trie_edge_t *edge =
+      std::lower_bound(begin, end, c, [](const key_trie_edge_t &e, int ch) { return e.c < ch; });
+  return edge != end && edge->c == c ? edge->node : -1;
 }
 
 static void unget_key_sequence(const key_sequence_t &sequence) {
@@ -337,7 +523,9 @@ static void unget_key_sequence(const key_sequence_t &sequence) {
 
 static key_t decode_sequence(bool outer) {
   key_sequence_t sequence;
-  mapping_t *matched;
+  /* Trie node corresponding to the sequence read so far, or -1 if it is not a prefix of any
+     known sequence. */
+  int node = key_trie_nodes.empty() ? -1 : 0;
   int c;
 
   sequence.idx = 1;
@@ -356,14 +544,12 @@ static key_t decode_sequence(bool outer) {
 
       sequence.data[sequence.idx++] = c;
 
-      is_prefix = false;
-      if ((matched = (mapping_t *)bsearch(&sequence, map, map_count, sizeof(mapping_t),
-                                          compare_sequence_with_mapping)) != nullptr)
-        return matched->key;
+      if (node >= 0 && (node = key_trie_step(node, c)) >= 0 && key_trie_nodes[node].is_key)
+        return key_trie_nodes[node].key;
 
       /* Detect and ignore ANSI CSI sequences, regardless of whether they are recognised.
          An exception is made for mouse events, which also start with CSI. */
-      if (sequence.data[1] == '[' && !is_prefix) {
+      if (sequence.data[1] == '[' && node < 0) {
         if (sequence.idx == 3 && c == 'M' && use_xterm_mouse_reporting()) {
           if (!outer) {
             /* If this is not the outer decode_sequence call, push everything
@@ -406,7 +592,7 @@ static key_t decode_sequence(bool outer) {
         continue;
       }
 
-      if (!is_prefix) goto unknown_sequence;
+      if (node < 0) goto unknown_sequence;
     }
 
     if (!read_keychar(outer ? key_timeout : 50)) break;
@@ -474,6 +660,31 @@ void insert_protected_key(key_t key) {
   if (key >= 0) key_buffer.push_back(key | EKEY_PROTECT);
 }
 
+void inject_key(key_t key) { key_buffer.push_back(key); }
+
+#ifdef HAS_EPOLL
+/* Wake up the input thread. This function is async-signal safe. */
+static void wakeup_read_keys() {
+  uint64_t value = 1;
+  if (wakeup_fd != -1)
+    nosig_write(wakeup_fd, reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static bool epoll_add(int fd, uint64_t id) {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = id;
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static void sigwinch_handler(int param) {
+  int saved_errno = errno;
+  (void)param;
+  winch_received = 1;
+  wakeup_read_keys();
+  errno = saved_errno;
+}
+#else
 static void sigwinch_handler(int param) {
   char winch_signal = WINCH_SIGNAL;
   int saved_errno = errno;
@@ -481,6 +692,7 @@ static void sigwinch_handler(int param) {
   nosig_write(signal_pipe[1], &winch_signal, 1);
   errno = saved_errno;
 }
+#endif
 
 static key_t map_kp(key_t kp) {
   size_t i;
@@ -489,21 +701,43 @@ static key_t map_kp(key_t kp) {
   return kp;
 }
 
-static int compare_mapping(const void *a, const void *b) {
-  const mapping_t *_a, *_b;
-  int result;
+static bool compare_mapping(const mapping_t &a, const mapping_t &b) {
+  int result = memcmp(a.string, b.string, std::min(a.string_length, b.string_length));
+  if (result != 0) return result < 0;
+  return a.string_length < b.string_length;
+}
+
+/* Build the (sub-)trie for the sorted sequences [@p begin, @p end), which all share their first
+   @p depth characters. Returns the index of the created node. */
+static int build_key_trie(const mapping_t *begin, const mapping_t *end, size_t depth) {
+  int node = key_trie_nodes.size();
+  key_trie_nodes.push_back(key_trie_node_t{0, false, 0, 0});
+
+  /* Because the sequences are sorted, those ending at this node (if any) come first. If the
+     terminal description contains duplicates, the last one wins. */
+  for (; begin != end && begin->string_length == depth; ++begin) {
+    key_trie_nodes[node].key = begin->key;
+    key_trie_nodes[node].is_key = true;
+  }
 
-  _a = (const mapping_t *)a;
-  _b = (const mapping_t *)b;
+  std::vector<std::pair<const mapping_t *, const mapping_t *>> groups;
+  while (begin != end) {
+    const mapping_t *group_end = begin;
+    while (group_end != end && group_end->string[depth] == begin->string[depth]) ++group_end;
+    groups.emplace_back(begin, group_end);
+    begin = group_end;
+  }
 
-  if ((result = memcmp(_a->string, _b->string, std::min(_a->string_length, _b->string_length))) !=
-      0)
-    return result;
-  if (_a->string_length < _b->string_length)
-    return -1;
-  else if (_a->string_length > _b->string_length)
-    return 1;
-  return 0;
+  int first_edge = key_trie_edges.size();
+  key_trie_nodes[node].first_edge = first_edge;
+  key_trie_nodes[node].edge_count = groups.size();
+  key_trie_edges.resize(first_edge + groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    int child = build_key_trie(groups[i].first, groups[i].second, depth + 1);
+    key_trie_edges[first_edge + i].c = groups[i].first->string[depth];
+    key_trie_edges[first_edge + i].node = child;
+  }
+  return node;
 }
 
 static bool is_function_key(const char *str) {
@@ -531,7 +765,8 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
   struct sigaction sa;
   sigset_t sigs;
   const t3_key_node_t *key_node;
-  int i, j, error, idx;
+  std::vector<mapping_t> map;
+  int i, j, error;
   transcript_error_t transcript_error;
   const char *shiftfn = nullptr;
 
@@ -539,11 +774,27 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
   if ((conversion_handle = transcript_open_converter(transcript_get_codeset(), TRANSCRIPT_UTF32, 0,
                                                      &transcript_error)) == nullptr)
     RETURN_ERROR(complex_error_t::SRC_TRANSCRIPT, transcript_error);
+  utf8_input = transcript_equal(transcript_get_codeset(), "UTF-8");
 
   if ((keymap = t3_key_load_map(term, nullptr, &error)) == nullptr)
     RETURN_ERROR(complex_error_t::SRC_T3_KEY, error);
 
+#ifdef HAS_EPOLL
+  if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    RETURN_ERROR(complex_error_t::SRC_ERRNO, errno);
+  if ((wakeup_fd = eventfd(0, EFD_CLOEXEC)) < 0) RETURN_ERROR(complex_error_t::SRC_ERRNO, errno);
+  stdin_always_ready = false;
+  if (!epoll_add(0, EPOLL_STDIN_ID)) {
+    if (errno != EPERM) RETURN_ERROR(complex_error_t::SRC_ERRNO, errno);
+    stdin_always_ready = true;
+  }
+  if (!epoll_add(wakeup_fd, EPOLL_WAKEUP_ID)) RETURN_ERROR(complex_error_t::SRC_ERRNO, errno);
+  quit_requested = false;
+  winch_received = 0;
+  exit_main_loop_requested = 0;
+#else
   if (pipe(signal_pipe) < 0) RETURN_ERROR(complex_error_t::SRC_ERRNO, errno);
+#endif
 
   sa.sa_handler = sigwinch_handler;
   sigemptyset(&sa.sa_mask);
@@ -583,28 +834,21 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
   t3_term_putp("\033[?2004h");
 
   init_mouse_reporting(t3_key_get_named_node(keymap, "_xterm_mouse") != nullptr);
+#ifdef HAS_EPOLL
+  if (get_mouse_fd() >= 0 && !epoll_add(get_mouse_fd(), EPOLL_MOUSE_ID))
+    lcprintf(LOG_INPUT, LOG_ERROR, "Could not add mouse fd to epoll set: %s\n", strerror(errno));
+#endif
 
   /* Load all the known keys from the terminfo database.
-     - find out how many sequences there are
-     - allocate an appropriate amount of memory
      - fill the map
-     - sort the map for quick searching
+     - sort the map
+     - convert the map into a trie, such that decode_sequence can look up the sequence
+       incrementally while reading it
   */
   for (key_node = keymap; key_node != nullptr; key_node = key_node->next) {
     if (key_node->key[0] == '_') continue;
-    if (key_node->string[0] == 27) map_count++;
-  }
-
-  if ((map = (mapping_t *)malloc(sizeof(mapping_t) * map_count)) == nullptr)
-    RETURN_ERROR(complex_error_t::SRC_ERRNO, ENOMEM);
-
-  for (key_node = keymap, idx = 0; key_node != nullptr; key_node = key_node->next) {
-    if (key_node->key[0] == '_') continue;
 
-    if (key_node->string[0] == 27) {
-      map[idx].string = key_node->string;
-      map[idx].string_length = key_node->string_length;
-    }
+    mapping_t mapping = {key_node->string, key_node->string_length, EKEY_IGNORE};
 
     for (i = 0; i < ARRAY_SIZE(key_strings); i++) {
       /* Check if this is a sequence we know. */
@@ -621,17 +865,17 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
         break;
       }
 
-      map[idx].key = separate_keypad ? key_strings[i].code : map_kp(key_strings[i].code);
+      mapping.key = separate_keypad ? key_strings[i].code : map_kp(key_strings[i].code);
       for (; key_node->key[j] != 0; j++) {
         switch (key_node->key[j]) {
           case 'c':
-            map[idx].key |= EKEY_CTRL;
+            mapping.key |= EKEY_CTRL;
             break;
           case 'm':
-            map[idx].key |= EKEY_META;
+            mapping.key |= EKEY_META;
             break;
           case 's':
-            map[idx].key |= EKEY_SHIFT;
+            mapping.key |= EKEY_SHIFT;
             break;
           default:
             break;
@@ -664,17 +908,19 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
           key |= EKEY_SHIFT;
         }
         if (key_node->string[0] == 27)
-          map[idx].key = key;
+          mapping.key = key;
         else
           map_single[(unsigned char)key_node->string[0]] = key;
-      } else {
-        if (key_node->string[0] == 27) map[idx].key = EKEY_IGNORE;
       }
     }
-    if (key_node->string[0] == 27) idx++;
+    if (key_node->string[0] == 27) map.push_back(mapping);
   }
-  qsort(map, map_count, sizeof(mapping_t), compare_mapping);
+  std::stable_sort(map.begin(), map.end(), compare_mapping);
+  build_key_trie(map.data(), map.data() + map.size(), 1);
 
+#ifdef HAS_EPOLL
+  init_event_sources(epoll_fd);
+#endif
   read_key_thread = std::thread(read_keys);
 
 #ifdef DEBUG
@@ -688,12 +934,14 @@ complex_error_t init_keys(const char *term, bool separate_keypad) {
 
 return_error:
   cleanup_keys();
+#ifndef HAS_EPOLL
   if (signal_pipe[0] != -1) {
     close(signal_pipe[0]);
     close(signal_pipe[1]);
     signal_pipe[0] = -1;
     signal_pipe[1] = -1;
   }
+#endif
   return result;
 }
 #undef RETURN_ERROR
@@ -723,21 +971,36 @@ void cleanup_keys() {
     t3_key_free_map(keymap);
     keymap = nullptr;
   }
-  if (map != nullptr) {
-    free(map);
-    map = nullptr;
-  }
+  key_trie_nodes.clear();
+  key_trie_edges.clear();
   memset(map_single, 0, sizeof(map_single));
   leave = nullptr;
   enter = nullptr;
 }
 
 static void stop_keys() {
+#ifdef HAS_EPOLL
+  if (read_key_thread.joinable()) {
+    quit_requested = true;
+    wakeup_read_keys();
+    read_key_thread.join();
+  }
+  cleanup_event_sources();
+  if (wakeup_fd != -1) {
+    close(wakeup_fd);
+    wakeup_fd = -1;
+  }
+  if (epoll_fd != -1) {
+    close(epoll_fd);
+    epoll_fd = -1;
+  }
+#else
   char quit_signal = QUIT_SIGNAL;
   nosig_write(signal_pipe[1], &quit_signal, 1);
   close(signal_pipe[1]);
   signal_pipe[1] = -1;
   read_key_thread.join();
+#endif
   stop_mouse_reporting();
   t3_term_putp(leave);
 }
@@ -763,11 +1026,33 @@ int get_key_timeout() {
 
 void signal_update() { key_buffer.push_back_unique(EKEY_EXTERNAL_UPDATE); }
 
+#ifdef HAS_EPOLL
+void signal_event_sources_changed() {
+  int saved_errno = errno;
+  wakeup_read_keys();
+  errno = saved_errno;
+}
+
+void async_safe_exit_main_loop(int exit_code) {
+  int saved_errno = errno;
+  exit_main_loop_requested = (exit_code & 0xff) + 1;
+  wakeup_read_keys();
+  errno = saved_errno;
+}
+#else
+void signal_event_sources_changed() {
+  char event_sources_signal = EVENT_SOURCES_SIGNAL;
+  int saved_errno = errno;
+  if (signal_pipe[1] != -1) nosig_write(signal_pipe[1], &event_sources_signal, 1);
+  errno = saved_errno;
+}
+
 void async_safe_exit_main_loop(int exit_code) {
   char exit_signal[2] = {EXIT_MAIN_LOOP_SIGNAL, static_cast<char>(exit_code & 0xff)};
   int saved_errno = errno;
   nosig_write(signal_pipe[1], exit_signal, 2);
   errno = saved_errno;
 }
+#endif
 
 };  // namespace
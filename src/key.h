@@ -126,6 +126,9 @@ enum {
   EKEY_PASTE_START = EKEY_EXIT_MAIN_LOOP + 256,
   /** Pasted text stops. */
   EKEY_PASTE_END,
+  /** Key symbol indicating that a file descriptor registered with #watch_fd is ready, or a timer
+      registered with #add_timer has expired. */
+  EKEY_EVENT_SOURCE,
 
   /** Symbolic name for the escape key. */
   EKEY_ESC = 27,
@@ -15,9 +15,12 @@
 #define T3_WIDGET_KEY_BINDING_H
 
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
 #include <vector>
 
+#include "key.h"
 #include "util.h"
 
 namespace t3_widget {
@@ -30,69 +33,181 @@ class key_bindings_base_t {
   virtual bool bind_key(key_t key, const std::string &name) = 0;
 };
 
+/** Mapping from keys to actions, and from action names to actions.
+
+    Keys consisting of an ASCII character combined with any of the modifiers EKEY_CTRL, EKEY_META
+    and EKEY_SHIFT, which make up almost all bindings, are looked up in a directly indexed table.
+    All other keys are stored in an open addressing hash table with linear probing. The names
+    are kept in a sorted vector, such that #names is constant time.
+
+    @p T must be an enumeration type with non-negative values.
+*/
 template <typename T>
 class key_bindings_t : public key_bindings_base_t {
  public:
   struct param_t {
     T action;
-    std::string name;
+    const char *name;
     std::initializer_list<key_t> bound_keys;
   };
 
-  key_bindings_t(std::initializer_list<param_t> actions) {
+  key_bindings_t(std::initializer_list<param_t> actions)
+      : dense_bindings(DENSE_SIZE, -1), hash_entries(0) {
+    name_mapping.reserve(actions.size());
     for (const param_t &action : actions) {
-      name_mapping[action.name] = action.action;
+      set_name(action.name, action.action);
       for (key_t key : action.bound_keys) {
         if (key >= 0) {
-          key_bindings[key] = action.action;
+          set_binding(key, action.action);
         }
       }
     }
   }
-  key_bindings_t() {}
+  key_bindings_t() : dense_bindings(DENSE_SIZE, -1), hash_entries(0) {}
 
   optional<T> find_action(key_t key) const {
-    typename std::map<key_t, T>::const_iterator iter = key_bindings.find(key);
-    if (iter == key_bindings.end()) {
-      return nullopt;
+    if (is_dense(key)) {
+      int action = dense_bindings[dense_index(key)];
+      if (action < 0) return nullopt;
+      return static_cast<T>(action);
+    }
+    /* Negative keys, like EKEY_IGNORE, can not be bound, and would match the unused entries. */
+    if (key < 0 || hash_entries == 0) return nullopt;
+    for (size_t idx = hash_index(key);; idx = (idx + 1) & (hash_table.size() - 1)) {
+      if (hash_table[idx].key == key) return hash_table[idx].action;
+      if (hash_table[idx].key < 0) return nullopt;
     }
-    return iter->second;
   }
 
   void bind_key(key_t key, optional<T> action) {
     if (action.is_valid()) {
-      key_bindings[key] = action;
+      set_binding(key, action);
     } else {
-      key_bindings.erase(key);
+      erase_binding(key);
     }
   }
 
   bool bind_key(key_t key, const std::string &name) override {
     if (name.empty()) {
-      key_bindings.erase(key);
+      erase_binding(key);
       return true;
     }
     optional<T> action = map_name(name);
     if (!action.is_valid()) return false;
-    key_bindings[key] = action;
+    set_binding(key, action);
     return true;
   }
 
   optional<T> map_name(const std::string &name) const {
-    typename std::map<std::string, T>::const_iterator iter = name_mapping.find(name);
-    if (iter == name_mapping.end()) return nullopt;
-    return iter->second;
+    typename std::vector<name_entry_t>::const_iterator iter = find_name(name);
+    if (iter == name_mapping.end() || iter->name != name) return nullopt;
+    return iter->action;
   }
 
   size_t names_size() const override { return name_mapping.size(); }
 
-  const std::string &names(size_t idx) const override {
-    return std::next(name_mapping.begin(), idx)->first;
-  }
+  const std::string &names(size_t idx) const override { return name_mapping[idx].name; }
 
  private:
-  std::map<std::string, T> name_mapping;
-  std::map<key_t, T> key_bindings;
+  struct name_entry_t {
+    std::string name;
+    T action;
+  };
+  /* Entry in the hash table. Unused entries have a negative key. */
+  struct hash_entry_t {
+    key_t key;
+    T action;
+  };
+
+  /* The modifiers covered by the dense table occupy the three bits starting at DENSE_MOD_SHIFT. */
+  enum {
+    DENSE_MOD_SHIFT = 28,
+    DENSE_MODIFIERS = EKEY_CTRL | EKEY_META | EKEY_SHIFT,
+    DENSE_SIZE = 8 * 128
+  };
+
+  static bool is_dense(key_t key) { return key >= 0 && (key & ~DENSE_MODIFIERS) < 128; }
+  static size_t dense_index(key_t key) {
+    return (static_cast<size_t>(key >> DENSE_MOD_SHIFT) << 7) | (key & 0x7f);
+  }
+  size_t hash_index(key_t key) const {
+    /* Fibonacci hashing. The table size is always a power of two. */
+    return (static_cast<uint32_t>(key) * UINT32_C(2654435769)) & (hash_table.size() - 1);
+  }
+
+  typename std::vector<name_entry_t>::const_iterator find_name(const std::string &name) const {
+    return std::lower_bound(
+        name_mapping.begin(), name_mapping.end(), name,
+        [](const name_entry_t &entry, const std::string &value) { return entry.name < value; });
+  }
+
+  void set_name(const char *name, T action) {
+    typename std::vector<name_entry_t>::const_iterator iter = find_name(name);
+    if (iter != name_mapping.end() && iter->name == name) {
+      name_mapping[iter - name_mapping.begin()].action = action;
+    } else {
+      name_mapping.insert(name_mapping.begin() + (iter - name_mapping.begin()),
+                          name_entry_t{name, action});
+    }
+  }
+
+  void set_binding(key_t key, T action) {
+    if (key < 0) return;
+    if (is_dense(key)) {
+      dense_bindings[dense_index(key)] = static_cast<int>(action);
+      return;
+    }
+    /* Keep the load factor at or below one half. */
+    if ((hash_entries + 1) * 2 > hash_table.size()) {
+      std::vector<hash_entry_t> old_table(hash_table.size() == 0 ? 16 : hash_table.size() * 2,
+                                          hash_entry_t{-1, T()});
+      old_table.swap(hash_table);
+      hash_entries = 0;
+      for (const hash_entry_t &entry : old_table) {
+        if (entry.key >= 0) set_binding(entry.key, entry.action);
+      }
+    }
+    size_t idx = hash_index(key);
+    while (hash_table[idx].key >= 0 && hash_table[idx].key != key) {
+      idx = (idx + 1) & (hash_table.size() - 1);
+    }
+    if (hash_table[idx].key < 0) {
+      hash_table[idx].key = key;
+      ++hash_entries;
+    }
+    hash_table[idx].action = action;
+  }
+
+  void erase_binding(key_t key) {
+    if (key < 0) return;
+    if (is_dense(key)) {
+      dense_bindings[dense_index(key)] = -1;
+      return;
+    }
+    if (hash_entries == 0) return;
+    size_t mask = hash_table.size() - 1;
+    size_t idx = hash_index(key);
+    while (hash_table[idx].key != key) {
+      if (hash_table[idx].key < 0) return;
+      idx = (idx + 1) & mask;
+    }
+    /* Shift back the entries following the removed entry which are not in their preferred
+       position, such that lookups do not need tombstones. */
+    for (size_t next = (idx + 1) & mask; hash_table[next].key >= 0; next = (next + 1) & mask) {
+      size_t preferred = hash_index(hash_table[next].key);
+      if (((next - preferred) & mask) >= ((next - idx) & mask)) {
+        hash_table[idx] = hash_table[next];
+        idx = next;
+      }
+    }
+    hash_table[idx].key = -1;
+    --hash_entries;
+  }
+
+  std::vector<name_entry_t> name_mapping;
+  std::vector<int> dense_bindings;
+  std::vector<hash_entry_t> hash_table;
+  size_t hash_entries;
 };
 
 }  // namespace t3_widget
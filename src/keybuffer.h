@@ -22,7 +22,10 @@
    mutex. It is implemented by means of a double ended queue.  */
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <condition_variable>
+#include <cstring>
 #include <deque>
 #include <mutex>
 
@@ -65,6 +68,21 @@ class T3_WIDGET_LOCAL item_buffer_t {
     items.pop_front();
     return result;
   }
+
+  /** Retrieve and remove the item at the front of the queue, waiting at most until @p deadline.
+      @return @c true if an item was retrieved, @c false if the deadline passed first.
+
+      If @p deadline has already passed, this function does not block at all.
+  */
+  bool pop_front_until(T *result, std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> l(lock);
+    while (items.empty()) {
+      if (cond.wait_until(l, deadline) == std::cv_status::timeout && items.empty()) return false;
+    }
+    *result = items.front();
+    items.pop_front();
+    return true;
+  }
 };
 
 /** Class implmementing a mutex-protected queue of key symbols. */
@@ -88,7 +106,121 @@ class T3_WIDGET_LOCAL key_buffer_t : public item_buffer_t<key_t> {
   }
 };
 
-typedef item_buffer_t<mouse_event_t> mouse_event_buffer_t;
+/** Class implementing a mutex-protected queue of mouse events, which merges similar events. */
+class T3_WIDGET_LOCAL mouse_event_buffer_t : public item_buffer_t<mouse_event_t> {
+ public:
+  /** Append an event to the list, or merge it with the last event in the queue.
+      @return @c true if the event was added as a new item, @c false if it was merged.
+
+      Events are only merged with an event that has not been retrieved yet, so each item in the
+      queue still corresponds to a single notification of the consumer.
+  */
+  bool push_back_merged(mouse_event_t event) {
+    std::unique_lock<std::mutex> l(lock);
+
+    if (!items.empty() && can_merge(items.back(), event)) {
+      items.back().x = event.x;
+      items.back().y = event.y;
+      if (items.back().count < SHRT_MAX) items.back().count++;
+      return false;
+    }
+
+    /* Catch all exceptions, to enusre that unlocking of the mutex is
+       performed. The only real exception that can occur here is bad_alloc,
+       and there is not much we can do about that anyway. */
+    try {
+      items.push_back(event);
+    } catch (...) {
+    }
+    cond.notify_one();
+    return true;
+  }
+
+ private:
+  static bool can_merge(const mouse_event_t &queued, const mouse_event_t &event) {
+    if (queued.type != event.type || queued.button_state != event.button_state ||
+        queued.previous_button_state != event.previous_button_state ||
+        queued.modifier_state != event.modifier_state)
+      return false;
+    if (event.type == EMOUSE_MOTION) return true;
+    /* Scroll wheel "presses" do not change the button state, so merging them does not affect
+       the detection of clicks. They are only merged when at the same location, such that they
+       are delivered to the same window. */
+    return event.type == EMOUSE_BUTTON_PRESS &&
+           (event.button_state & ~event.previous_button_state &
+            (EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN)) != 0 &&
+           queued.x == event.x && queued.y == event.y;
+  }
+};
+
+/** Fixed size buffer for input characters, which are consumed from the front.
+
+    The contents are kept contiguous, such that they can be passed to conversion
+    routines directly. Removing items from the front only moves the read cursor,
+    and items pushed back to the front after reading are stored in the space
+    before the read cursor. Only when there is no space at the end or the front,
+    the contents are moved. Not thread-safe: it is only used from the input thread.
+*/
+template <class T, int N>
+class T3_WIDGET_LOCAL input_buffer_t {
+ public:
+  int size() const { return write_pos - read_pos; }
+  bool empty() const { return read_pos == write_pos; }
+  bool full() const { return size() == N; }
+  /** Pointer to the first item. The items up to #size are contiguous. */
+  T *data() { return buffer + read_pos; }
+  T &operator[](int idx) { return buffer[read_pos + idx]; }
+
+  /** Append an item. @return @c false if the buffer is full. */
+  bool push_back(T item) {
+    if (write_pos == N && !compact()) return false;
+    buffer[write_pos++] = item;
+    return true;
+  }
+  /** Retrieve and remove the first item. The buffer must not be empty. */
+  T pop_front() { return buffer[read_pos++]; }
+  /** Remove the first @p count items. */
+  void erase_front(int count) {
+    read_pos = std::min(read_pos + count, write_pos);
+    if (read_pos == write_pos) read_pos = write_pos = 0;
+  }
+  /** Insert an item at the front. If the buffer is full, the last item is dropped. */
+  void push_front(T item) {
+    if (read_pos == 0) {
+      if (write_pos == N) --write_pos;
+      /* Move the contents halfway into the free space, such that subsequent calls need not move
+         anything. */
+      int shift = (N - write_pos + 1) / 2;
+      memmove(buffer + shift, buffer, write_pos * sizeof(T));
+      read_pos += shift;
+      write_pos += shift;
+    }
+    buffer[--read_pos] = item;
+  }
+
+  /** Pointer to the free space after the last item. Use #commit to append items written there. */
+  T *tail() {
+    if (write_pos == N) compact();
+    return buffer + write_pos;
+  }
+  /** Number of items which can be written at #tail. */
+  int tail_space() const { return N - write_pos; }
+  /** Append @p count items written at #tail. */
+  void commit(int count) { write_pos += count; }
+
+ private:
+  /** Move the contents to the start of the buffer. @return @c false if there is no space. */
+  bool compact() {
+    if (read_pos == 0) return write_pos < N;
+    memmove(buffer, buffer + read_pos, (write_pos - read_pos) * sizeof(T));
+    write_pos -= read_pos;
+    read_pos = 0;
+    return true;
+  }
+
+  T buffer[N];
+  int read_pos = 0, write_pos = 0;
+};
 
 };  // namespace
 #endif
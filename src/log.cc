@@ -12,57 +12,478 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace t3_widget {
 
-#ifdef _T3_WIDGET_DEBUG
-static FILE *log_file;
+std::atomic<int> log_max_level[LOG_CATEGORY_COUNT] = {{-1}, {-1}, {-1}, {-1}};
+
+namespace {
+
+const char *const level_names[] = {"error", "warning", "info", "debug"};
+const char *const category_names[] = {"general", "input", "clipboard", "widgets"};
+
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_SPACE 128
+#define LOG_FORMAT_SPACE 128
+#define LOG_RING_SIZE 1024
+
+/* A single log message. The format string is copied into the fmt member, as it may be owned by
+   a clipboard module that is unloaded before the record is written. The arguments are stored in
+   the order in which they are used by the format string, with any string arguments copied into
+   the strings member. */
+struct log_record_t {
+  std::chrono::steady_clock::time_point time;
+  char fmt[LOG_FORMAT_SPACE];
+  unsigned char category, level, nargs;
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+    size_t str;  // Offset in strings.
+  } args[LOG_MAX_ARGS];
+  char strings[LOG_STRING_SPACE];
+};
+
+/* Single producer, single consumer ring buffer. The producer is the thread owning the buffer,
+   the consumer the background thread. */
+struct log_ring_t {
+  std::atomic<size_t> head{0}, tail{0};
+  std::atomic<unsigned long> dropped{0};
+  log_record_t records[LOG_RING_SIZE];
+};
+
+/* The rings of all threads that have logged something. Rings are not freed when their thread
+   ends, as the number of threads used by the library is small and fixed. */
+std::mutex rings_lock;
+std::vector<log_ring_t *> rings;
+thread_local log_ring_t *thread_ring;
+
+FILE *log_file;
+std::thread *log_thread;
+std::mutex log_lock;
+std::condition_variable log_wakeup;
+bool log_stop;
+std::chrono::steady_clock::time_point log_start;
+
+/* The parts of a printf conversion specification that are needed to store and re-create it. */
+struct conversion_t {
+  const char *start, *end;
+  bool width_arg, precision_arg;
+  /* Number of 'h' or 'l' characters, with 'j', 'z' and 't' counted as a single 'l'. */
+  int shorts, longs;
+  bool long_double;
+  char conversion;
+};
+
+/* Parse the conversion specification starting at the '%' at @p fmt. */
+conversion_t parse_conversion(const char *fmt) {
+  conversion_t result;
+  result.start = fmt++;
+  result.width_arg = result.precision_arg = false;
+  result.shorts = result.longs = 0;
+  result.long_double = false;
+
+  while (*fmt != 0 && strchr("-+ #0'", *fmt) != nullptr) fmt++;
+  if (*fmt == '*') {
+    result.width_arg = true;
+    fmt++;
+  }
+  while (*fmt >= '0' && *fmt <= '9') fmt++;
+  if (*fmt == '.') {
+    fmt++;
+    if (*fmt == '*') {
+      result.precision_arg = true;
+      fmt++;
+    }
+    while (*fmt >= '0' && *fmt <= '9') fmt++;
+  }
+  for (;; fmt++) {
+    if (*fmt == 'h') {
+      result.shorts++;
+    } else if (*fmt == 'l') {
+      result.longs++;
+    } else if (*fmt == 'j' || *fmt == 'z' || *fmt == 't') {
+      result.longs = sizeof(long) == 8 ? 1 : 2;
+    } else if (*fmt == 'L') {
+      result.long_double = true;
+    } else {
+      break;
+    }
+  }
+  result.conversion = *fmt;
+  result.end = *fmt == 0 ? fmt : fmt + 1;
+  return result;
+}
+
+/* Copy the format string into @p record. Format strings that are too long are truncated, but keep
+   their final newline. */
+void store_format(log_record_t *record, const char *fmt) {
+  size_t length = strlen(fmt);
+  if (length < LOG_FORMAT_SPACE) {
+    memcpy(record->fmt, fmt, length + 1);
+    return;
+  }
+  memcpy(record->fmt, fmt, LOG_FORMAT_SPACE - 1);
+  if (fmt[length - 1] == '\n') record->fmt[LOG_FORMAT_SPACE - 2] = '\n';
+  record->fmt[LOG_FORMAT_SPACE - 1] = 0;
+}
+
+/* Store the arguments of a message in @p record. Messages with more arguments than fit in the
+   record are cut off when written. */
+void store_args(log_record_t *record, const char *fmt, va_list args) {
+  size_t string_fill = 0;
+
+  record->nargs = 0;
+  while ((fmt = strchr(fmt, '%')) != nullptr) {
+    conversion_t conversion = parse_conversion(fmt);
+    fmt = conversion.end;
+    if (conversion.conversion == '%') continue;
+
+    int needed = 1 + conversion.width_arg + conversion.precision_arg;
+    if (record->nargs + needed > LOG_MAX_ARGS) return;
+    if (conversion.width_arg) record->args[record->nargs++].i = va_arg(args, int);
+    if (conversion.precision_arg) record->args[record->nargs++].i = va_arg(args, int);
+
+    auto &arg = record->args[record->nargs++];
+    switch (conversion.conversion) {
+      case 'd':
+      case 'i':
+        if (conversion.longs >= 2) {
+          arg.i = va_arg(args, long long);
+        } else if (conversion.longs == 1) {
+          arg.i = va_arg(args, long);
+        } else {
+          arg.i = va_arg(args, int);
+          if (conversion.shorts == 1) arg.i = static_cast<short>(arg.i);
+          if (conversion.shorts >= 2) arg.i = static_cast<signed char>(arg.i);
+        }
+        break;
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        if (conversion.longs >= 2) {
+          arg.u = va_arg(args, unsigned long long);
+        } else if (conversion.longs == 1) {
+          arg.u = va_arg(args, unsigned long);
+        } else {
+          arg.u = va_arg(args, unsigned int);
+          if (conversion.shorts == 1) arg.u = static_cast<unsigned short>(arg.u);
+          if (conversion.shorts >= 2) arg.u = static_cast<unsigned char>(arg.u);
+        }
+        break;
+      case 'c':
+        arg.i = va_arg(args, int);
+        break;
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        arg.d = conversion.long_double ? static_cast<double>(va_arg(args, long double))
+                                       : va_arg(args, double);
+        break;
+      case 's': {
+        const char *str = va_arg(args, const char *);
+        if (str == nullptr) str = "(null)";
+        size_t length = std::min(strlen(str), LOG_STRING_SPACE - 1 - string_fill);
+        memcpy(record->strings + string_fill, str, length);
+        record->strings[string_fill + length] = 0;
+        arg.str = string_fill;
+        string_fill += length + (string_fill + length < LOG_STRING_SPACE - 1);
+        break;
+      }
+      case 'p':
+        arg.p = va_arg(args, void *);
+        break;
+      default:
+        // Unsupported conversions, such as %n, end the message.
+        record->nargs--;
+        return;
+    }
+  }
+}
+
+/* Format a stored message, and write it to the log file. */
+void write_record(const log_record_t *record) {
+  const char *fmt = record->fmt;
+  int next_arg = 0;
+  char spec[128];
+
+  while (*fmt != 0) {
+    const char *percent = strchr(fmt, '%');
+    if (percent == nullptr) {
+      fputs(fmt, log_file);
+      break;
+    }
+    fwrite(fmt, 1, percent - fmt, log_file);
+    conversion_t conversion = parse_conversion(percent);
+    fmt = conversion.end;
+    if (conversion.conversion == '%') {
+      fputc('%', log_file);
+      continue;
+    }
+
+    int needed = 1 + conversion.width_arg + conversion.precision_arg;
+    if (next_arg + needed > record->nargs) {
+      size_t length = strlen(fmt);
+      fputs(length > 0 && fmt[length - 1] == '\n' ? "...\n" : "...", log_file);
+      break;
+    }
+
+    /* Re-create the conversion specification, with the width and precision arguments filled in
+       and the length modifiers replaced by those of the stored type. */
+    std::string format;
+    for (const char *ptr = conversion.start; ptr < conversion.end - 1; ptr++) {
+      if (*ptr == '*') {
+        format += std::to_string(record->args[next_arg++].i);
+      } else if (strchr("hljztL", *ptr) == nullptr) {
+        format += *ptr;
+      }
+    }
+
+    const auto &arg = record->args[next_arg++];
+    switch (conversion.conversion) {
+      case 'd':
+      case 'i':
+        format += "ll";
+        format += conversion.conversion;
+        snprintf(spec, sizeof(spec), format.c_str(), arg.i);
+        fputs(spec, log_file);
+        break;
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        format += "ll";
+        format += conversion.conversion;
+        snprintf(spec, sizeof(spec), format.c_str(), arg.u);
+        fputs(spec, log_file);
+        break;
+      case 'c':
+        format += 'c';
+        snprintf(spec, sizeof(spec), format.c_str(), static_cast<int>(arg.i));
+        fputs(spec, log_file);
+        break;
+      case 's':
+        format += 's';
+        fprintf(log_file, format.c_str(), record->strings + arg.str);
+        break;
+      case 'p':
+        format += 'p';
+        snprintf(spec, sizeof(spec), format.c_str(), arg.p);
+        fputs(spec, log_file);
+        break;
+      default:
+        format += conversion.conversion;
+        snprintf(spec, sizeof(spec), format.c_str(), arg.d);
+        fputs(spec, log_file);
+        break;
+    }
+  }
+}
+
+/* Collect the records from all rings, and write them to the log file in chronological order. */
+void drain_rings() {
+  static bool at_line_start = true;
+  std::vector<log_record_t> batch;
+  unsigned long dropped = 0;
+
+  {
+    std::unique_lock<std::mutex> l(rings_lock);
+    for (log_ring_t *ring : rings) {
+      size_t head = ring->head.load(std::memory_order_relaxed);
+      size_t tail = ring->tail.load(std::memory_order_acquire);
+      for (; head != tail; head++) batch.push_back(ring->records[head % LOG_RING_SIZE]);
+      ring->head.store(head, std::memory_order_release);
+      dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::stable_sort(batch.begin(), batch.end(), [](const log_record_t &a, const log_record_t &b) {
+    return a.time < b.time;
+  });
 
-static void close_log() { fclose(log_file); }
+  for (const log_record_t &record : batch) {
+    if (at_line_start) {
+      fprintf(log_file, "%.6f %s %s: ",
+              std::chrono::duration<double>(record.time - log_start).count(),
+              category_names[record.category], level_names[record.level]);
+    }
+    write_record(&record);
+    size_t length = strlen(record.fmt);
+    at_line_start = length > 0 && record.fmt[length - 1] == '\n';
+  }
+  if (dropped > 0) {
+    fprintf(log_file, "%s%lu log messages dropped because a ring buffer was full\n",
+            at_line_start ? "" : "\n", dropped);
+    at_line_start = true;
+  }
+  if (!batch.empty() || dropped > 0) fflush(log_file);
+}
+
+void log_thread_main() {
+  std::unique_lock<std::mutex> l(log_lock);
+  while (!log_stop) {
+    log_wakeup.wait_for(l, std::chrono::milliseconds(100));
+    l.unlock();
+    drain_rings();
+    l.lock();
+  }
+}
+
+void close_log() {
+  for (int i = 0; i < LOG_CATEGORY_COUNT; ++i) set_log_level(static_cast<log_category_t>(i), -1);
+  {
+    std::unique_lock<std::mutex> l(log_lock);
+    log_stop = true;
+  }
+  log_wakeup.notify_one();
+  log_thread->join();
+  delete log_thread;
+  drain_rings();
+  fclose(log_file);
+}
+
+/* Parse a level name, returning -1 for "none" and -2 for unknown names. */
+int parse_level(const std::string &name) {
+  if (name == "none") return -1;
+  for (int i = 0; i < static_cast<int>(sizeof(level_names) / sizeof(level_names[0])); ++i) {
+    if (name == level_names[i]) return i;
+  }
+  return -2;
+}
+
+/* Apply the settings from the T3_WIDGET_LOG environment variable. */
+void parse_log_settings(const char *settings) {
+  std::string setting;
+
+  for (const char *ptr = settings;; ptr++) {
+    if (*ptr != ',' && *ptr != 0) {
+      setting += *ptr;
+      continue;
+    }
+
+    size_t colon = setting.find(':');
+    int level = parse_level(colon == std::string::npos ? setting : setting.substr(colon + 1));
+    if (level >= -1) {
+      for (int i = 0; i < LOG_CATEGORY_COUNT; ++i) {
+        if (colon == std::string::npos || setting.compare(0, colon, category_names[i]) == 0)
+          set_log_level(static_cast<log_category_t>(i), level);
+      }
+    }
+    setting.clear();
+    if (*ptr == 0) break;
+  }
+}
+
+}  // namespace
 
 void init_log() {
+  const char *settings;
+
+  if (log_file != nullptr) return;
+
+#ifdef _T3_WIDGET_DEBUG
+  for (int i = 0; i < LOG_CATEGORY_COUNT; ++i)
+    set_log_level(static_cast<log_category_t>(i), LOG_DEBUG);
+#endif
+  if ((settings = getenv("T3_WIDGET_LOG")) != nullptr) parse_log_settings(settings);
+
+  bool any_enabled = false;
+  for (int i = 0; i < LOG_CATEGORY_COUNT; ++i) any_enabled |= log_max_level[i] >= 0;
+  if (any_enabled) log_file = fopen("libt3widgetlog.txt", "a");
+
   if (log_file == nullptr) {
-    log_file = fopen("libt3widgetlog.txt", "a");
-    if (log_file) atexit(close_log);
+    // Make sure no records are collected which will never be written.
+    for (int i = 0; i < LOG_CATEGORY_COUNT; ++i) set_log_level(static_cast<log_category_t>(i), -1);
+    return;
   }
+  log_start = std::chrono::steady_clock::now();
+  log_thread = new std::thread(log_thread_main);
+  atexit(close_log);
+}
+
+void set_log_level(log_category_t category, int level) {
+  log_max_level[category].store(level, std::memory_order_relaxed);
 }
 
-void lprintf(const char *fmt, ...) {
-  if (log_file) {
-    va_list args;
+void log_message(log_category_t category, log_level_t level, const char *fmt, ...) {
+  log_ring_t *ring = thread_ring;
+
+  if (log_file == nullptr) return;
 
-    va_start(args, fmt);
-    vfprintf(log_file, fmt, args);
-    fflush(log_file);
-    va_end(args);
+  if (ring == nullptr) {
+    ring = thread_ring = new log_ring_t();
+    std::unique_lock<std::mutex> l(rings_lock);
+    rings.push_back(ring);
   }
+
+  size_t tail = ring->tail.load(std::memory_order_relaxed);
+  size_t head = ring->head.load(std::memory_order_acquire);
+  if (tail - head >= LOG_RING_SIZE) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  log_record_t *record = &ring->records[tail % LOG_RING_SIZE];
+  va_list args;
+  record->time = std::chrono::steady_clock::now();
+  store_format(record, fmt);
+  record->category = category;
+  record->level = level;
+  va_start(args, fmt);
+  store_args(record, record->fmt, args);
+  va_end(args);
+  ring->tail.store(tail + 1, std::memory_order_release);
+
+  // Wake the background thread early when the ring fills up, to avoid dropping messages.
+  if (tail + 1 - head == LOG_RING_SIZE / 2) log_wakeup.notify_one();
 }
 
 void ldumpstr(const char *str, int length) {
+  std::string escaped;
+  char buffer[8];
+
+  if (!log_enabled(LOG_GENERAL, LOG_DEBUG)) return;
+
   for (; length > 0; length--, str++) {
-    if ((unsigned int)*str < 32)
-      fprintf(log_file, "\\x%02X", *str);
-    else if (*str == '\\')
-      fprintf(log_file, "\\\\");
-    else
-      fputc(*str, log_file);
-  }
-  fflush(log_file);
+    if ((unsigned int)*str < 32) {
+      sprintf(buffer, "\\x%02X", *str);
+      escaped += buffer;
+    } else if (*str == '\\') {
+      escaped += "\\\\";
+    } else {
+      escaped += *str;
+    }
+  }
+  /* String arguments are truncated to the space in a record, so write the dump in pieces. */
+  for (size_t i = 0; i < escaped.size(); i += LOG_STRING_SPACE - 1)
+    lprintf("%s", escaped.substr(i, LOG_STRING_SPACE - 1).c_str());
 }
 
 void logkeyseq(const char *keys) {
+  std::string sequence;
   size_t i;
 
-  if (!log_file) return;
+  if (!log_enabled(LOG_INPUT, LOG_DEBUG)) return;
 
-  fprintf(log_file, "Unknown key sequence:");
-  for (i = 0; i < strlen(keys); i++) fprintf(log_file, " %d", keys[i]);
-  fprintf(log_file, "\n");
-  fflush(log_file);
+  for (i = 0; i < strlen(keys); i++) sequence += " " + std::to_string(keys[i]);
+  lcprintf(LOG_INPUT, LOG_DEBUG, "Unknown key sequence:%s\n", sequence.c_str());
 }
-#endif
 
 };  // namespace
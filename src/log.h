@@ -18,33 +18,58 @@
 #error This header file is for internal use _only_!!
 #endif
 
-#ifdef _T3_WIDGET_DEBUG
+#include <atomic>
 #include <typeinfo>
-#endif
 
 #include <stdio.h>
 
 #include "widget_api.h"
 namespace t3_widget {
 
-#ifdef _T3_WIDGET_DEBUG
+/* Logging is cheap enough to be left compiled in: a disabled message costs a single load and
+   compare, while an enabled message is stored as a fixed-size binary record in a ring buffer of
+   the calling thread. The records are formatted and written to libt3widgetlog.txt by a
+   background thread.
+
+   Which messages are logged is determined per category by a maximum level. By default all
+   messages are logged in debug builds, and none otherwise. The environment variable
+   T3_WIDGET_LOG overrides the default. It contains a comma separated list of levels, optionally
+   prefixed by a category and a colon. For example, "warning,input:debug" logs warnings and
+   errors for all categories, and all messages for the input category.
+
+   The format string and arguments of a message are copied when it is logged. Strings, including
+   the format string, are truncated to fit in the record. */
+enum log_level_t { LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_DEBUG };
+enum log_category_t { LOG_GENERAL, LOG_INPUT, LOG_CLIPBOARD, LOG_WIDGETS, LOG_CATEGORY_COUNT };
+
+/* The maximum level logged for each category, or -1 to log nothing. */
+T3_WIDGET_API extern std::atomic<int> log_max_level[LOG_CATEGORY_COUNT];
+
+static inline bool log_enabled(log_category_t category, log_level_t level) {
+  return static_cast<int>(level) <= log_max_level[category].load(std::memory_order_relaxed);
+}
 
 T3_WIDGET_LOCAL void init_log();
+/* Set the maximum level logged for @p category. A level of -1 disables logging. */
+T3_WIDGET_API void set_log_level(log_category_t category, int level);
+
 /* Note: these must be declared with T3_WIDGET_API such that they can be accessed
-   from the clipboard modules. */
-T3_WIDGET_API void lprintf(const char *fmt, ...)
+   from the clipboard modules. Use the lprintf and lcprintf macros instead of calling
+   log_message directly, as these avoid evaluating the arguments for disabled messages. */
+T3_WIDGET_API void log_message(log_category_t category, log_level_t level, const char *fmt, ...)
 #ifdef __GNUC__
-    __attribute__((format(printf, 1, 2)))
+    __attribute__((format(printf, 3, 4)))
 #endif
     ;
 T3_WIDGET_API void ldumpstr(const char *str, int length);
 T3_WIDGET_API void logkeyseq(const char *keys);
-#else
-#define init_log()
-#define lprintf(fmt, ...)
-#define ldumpstr(str, length)
-#define logkeyseq(keys)
-#endif
+
+#define lcprintf(category, level, ...)                      \
+  do {                                                      \
+    if (t3_widget::log_enabled(category, level))            \
+      t3_widget::log_message(category, level, __VA_ARGS__); \
+  } while (0)
+#define lprintf(...) lcprintf(t3_widget::LOG_GENERAL, t3_widget::LOG_DEBUG, __VA_ARGS__)
 
 };  // namespace
 #endif
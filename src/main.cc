@@ -13,6 +13,7 @@
 */
 
 #include <cerrno>
+#include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <cstring>
@@ -36,12 +37,19 @@ namespace t3_widget {
 #define MESSAGE_DIALOG_WIDTH 50
 #define MIN_LINES 16
 #define MIN_COLUMNS 60
+#define DEFAULT_MAX_INPUT_LATENCY 100
 
 static int init_level;
 static int screen_lines, screen_columns;
 static signals::signal<void, int, int> resize;
 static signals::signal<void> update_notification;
 
+/* Minimal time between two screen updates. Zero means no limit. */
+static std::chrono::steady_clock::duration min_frame_interval;
+/* Maximal time spent processing queued input before the screen is updated. */
+static std::chrono::steady_clock::duration max_input_latency =
+    std::chrono::milliseconds(DEFAULT_MAX_INPUT_LATENCY);
+
 init_parameters_t *init_params;
 bool disable_primary_selection;
 
@@ -113,7 +121,10 @@ init_parameters_t::init_parameters_t()
     : program_name(nullptr),
       term(nullptr),
       separate_keypad(false),
-      disable_external_clipboard(false) {}
+      disable_external_clipboard(false),
+      headless(false),
+      headless_lines(24),
+      headless_columns(80) {}
 
 signals::connection connect_resize(const signals::slot<void, int, int> &slot) {
   return resize.connect(slot);
@@ -242,6 +253,7 @@ void restore() {
       t3_term_restore();
     /* FALLTHROUGH */
     case 0:
+      close_headless_terminal();
       if (init_params != nullptr) {
         free(const_cast<char *>(init_params->term));
         init_params->term = nullptr;
@@ -266,7 +278,16 @@ complex_error_t init(const init_parameters_t *params) {
 
   if (init_params == nullptr) init_params = init_parameters_t::create();
 
-  if (params == nullptr || params->term == nullptr) {
+  if (params != nullptr && params->headless) {
+    init_params->headless = true;
+    init_params->headless_lines = params->headless_lines;
+    init_params->headless_columns = params->headless_columns;
+  }
+
+  if (init_params->headless && (params == nullptr || params->term == nullptr)) {
+    /* The emulator only understands the xterm control sequences. */
+    init_params->term = _t3_widget_strdup("xterm");
+  } else if (params == nullptr || params->term == nullptr) {
     const char *term_env = getenv("TERM");
     /* If term_env == nullptr, t3_term_init will abort anyway, so we ignore
        that case. */
@@ -279,11 +300,24 @@ complex_error_t init(const init_parameters_t *params) {
     init_params->program_name =
         _t3_widget_strdup(params->program_name == nullptr ? "This program" : params->program_name);
     init_params->separate_keypad = params->separate_keypad;
-    init_params->disable_external_clipboard = params->disable_external_clipboard;
+    init_params->disable_external_clipboard =
+        params->disable_external_clipboard || params->headless;
   }
 
   atexit(restore);
-  if ((term_init_result = t3_term_init(-1, init_params->term)) != T3_ERR_SUCCESS) {
+  int terminal_fd = -1;
+  if (init_params->headless) {
+    terminal_fd =
+        open_headless_terminal(init_params->headless_lines, init_params->headless_columns);
+    if (terminal_fd < 0) {
+      int saved_errno = errno;
+      restore();
+      result.set_error(complex_error_t::SRC_ERRNO, saved_errno);
+      errno = saved_errno;
+      return result;
+    }
+  }
+  if ((term_init_result = t3_term_init(terminal_fd, init_params->term)) != T3_ERR_SUCCESS) {
     int saved_errno = errno;
     restore();
     result.set_error(complex_error_t::SRC_T3_WINDOW, term_init_result);
@@ -324,19 +358,16 @@ complex_error_t init(const init_parameters_t *params) {
   return result;
 }
 
-void iterate() {
-  key_t key;
-
-  dialog_t::update_dialogs();
-  t3_term_update();
-  key = read_key();
+void process_input_key(key_t key) {
+  trace_scope_t trace("process_key");
   if (key == EKEY_MOUSE_EVENT) {
     mouse_event_t event = read_mouse_event();
-    lprintf("Got mouse event: x=%d, y=%d, button_state=%d, modifier_state=%d\n", event.x, event.y,
-            event.button_state, event.modifier_state);
+    lcprintf(LOG_INPUT, LOG_DEBUG,
+             "Got mouse event: x=%d, y=%d, button_state=%d, modifier_state=%d\n", event.x, event.y,
+             event.button_state, event.modifier_state);
     mouse_target_t::handle_mouse_event(event);
   } else {
-    lprintf("Got key %04X\n", key);
+    lcprintf(LOG_INPUT, LOG_DEBUG, "Got key %04X\n", key);
     switch (key) {
       case EKEY_RESIZE:
         do_resize();
@@ -347,6 +378,9 @@ void iterate() {
       case EKEY_UPDATE_TERMINAL:
         terminal_settings_changed()();
         break;
+      case EKEY_EVENT_SOURCE:
+        dispatch_event_sources();
+        break;
       default:
         if (key >= EKEY_EXIT_MAIN_LOOP && key <= EKEY_EXIT_MAIN_LOOP + 255)
           exit_main_loop(key - EKEY_EXIT_MAIN_LOOP);
@@ -357,10 +391,49 @@ void iterate() {
   }
 }
 
-struct main_loop_exit_t {
-  int retval;
-  main_loop_exit_t(int _retval) : retval(_retval) {}
-};
+void iterate() {
+  key_t key;
+  std::chrono::steady_clock::time_point next_frame, deadline, now;
+
+  {
+    trace_scope_t trace("update_dialogs");
+    dialog_t::update_dialogs();
+  }
+  {
+    trace_scope_t trace("t3_term_update");
+    t3_term_update();
+  }
+  next_frame = std::chrono::steady_clock::now() + min_frame_interval;
+
+  {
+    trace_scope_t trace("read_key");
+    key = read_key();
+  }
+  /* Handle all keys and mouse events that are already queued before updating the screen again.
+     This way a burst of input (key repeat, pasting, a slow connection catching up) results in a
+     single screen update, rather than one for each key. To keep the program responsive, the
+     screen is updated anyway once max_input_latency has passed. If a frame rate limit is set,
+     keep collecting input until the minimal frame interval has passed. */
+  deadline = std::chrono::steady_clock::now() + max_input_latency;
+  do {
+    process_input_key(key);
+    now = std::chrono::steady_clock::now();
+  } while (now < deadline &&
+           read_key_until(&key, now < next_frame ? std::min(next_frame, deadline) : now));
+}
+
+void set_max_frame_rate(int fps) {
+  if (fps <= 0)
+    min_frame_interval = std::chrono::steady_clock::duration::zero();
+  else
+    min_frame_interval =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) /
+        fps;
+}
+
+void set_max_input_latency(int msec) {
+  max_input_latency = std::chrono::milliseconds(msec < 0 ? 0 : msec);
+}
 
 int main_loop() {
   try {
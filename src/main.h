@@ -78,6 +78,15 @@ class T3_WIDGET_API init_parameters_t {
       we may be able to connect to it. For example, if it is connected over a
       slow link. */
   bool disable_external_clipboard;
+  /** Boolean indicating whether to run without a terminal.
+
+      In headless mode, a pseudo terminal is used instead of the terminal the program runs in, and
+      the screen contents are maintained in memory. See headless.h for the functions to drive the
+      widgets and read back the screen. The external clipboard is disabled in headless mode, and
+      #term defaults to @c xterm. */
+  bool headless;
+  int headless_lines,   /**< Number of lines of the screen in headless mode. Default 24. */
+      headless_columns; /**< Number of columns of the screen in headless mode. Default 80. */
 
   /** Construct a new init_parameters_t object. */
   static init_parameters_t *create();
@@ -124,8 +133,12 @@ T3_WIDGET_API complex_error_t init(const init_parameters_t *params);
 T3_WIDGET_API void restore();
 /** Perform a single iteration of the main loop.
     This function updates the contents of the terminal, waits for a key press
-        and sends it to the currently focussed dialog. Called repeatedly from
-    #main_loop.
+        and sends it to the currently focussed dialog. Any further keys and mouse
+    events which are already queued are handled as well, before returning. Called
+    repeatedly from #main_loop.
+
+    See #set_max_frame_rate and #set_max_input_latency for controlling how much
+    input is handled in a single iteration.
 */
 T3_WIDGET_API void iterate();
 /** Run the main event loop of the libt3widget library.
@@ -133,6 +146,20 @@ T3_WIDGET_API void iterate();
     value passed to that function.
 */
 T3_WIDGET_API int main_loop();
+/** Limit the number of screen updates per second.
+    By default, the screen is updated as soon as all queued input has been
+    handled. When running over a slow connection, it may be beneficial to
+    collect more input before sending the updated screen contents. A value of
+    zero or less disables the limit.
+*/
+T3_WIDGET_API void set_max_frame_rate(int fps);
+/** Set the maximum time in milliseconds spent handling queued input before the screen is updated.
+    When a large amount of input is queued, #iterate handles it in one go
+    without updating the screen. To ensure the user still gets some feedback,
+    the screen is updated after at most @p msec milliseconds. The default is
+    100 milliseconds. A value of zero results in a screen update after every key.
+*/
+T3_WIDGET_API void set_max_input_latency(int msec);
 /** Suspend execution of this program by sending a @c SIGSTOP signal.
     Before sending the @c SIGSTOP signal, the terminal is reset to its original
     state. This allows the parent process (usually the shell) to continue
@@ -164,6 +191,47 @@ T3_WIDGET_API void exit_main_loop(int exit_code)
 */
 T3_WIDGET_API void async_safe_exit_main_loop(int exit_code);
 
+/** Conditions to wait for on a file descriptor, for use with #watch_fd. */
+enum {
+  EWATCH_READ = (1 << 0), /**< Wait for the file descriptor to become readable. */
+  EWATCH_WRITE = (1 << 1) /**< Wait for the file descriptor to become writable. */
+};
+
+/** Watch a file descriptor from the main loop.
+    @param fd The file descriptor to watch.
+    @param events A bitmask of @c EWATCH_READ and @c EWATCH_WRITE, indicating the conditions to
+        wait for.
+    @param slot The callback to call when the file descriptor is ready. It receives the subset of
+        @p events which is ready.
+    @return A connection which can be used to stop watching the file descriptor.
+
+    The file descriptor is monitored by the input handling thread, but @p slot is
+    always called from the thread running #main_loop, such that it can update
+    widgets. While the callback is pending or running, the file descriptor is not
+    monitored. Thus, if the callback does not consume all available data, it will
+    simply be called again in a next iteration of the main loop. The file
+    descriptor must remain open until the watch is disconnected, and only a
+    single watch per file descriptor is supported. Like for @c select(2), regular
+    files are always considered ready.
+
+    This function can be called from any thread, and also before #init.
+*/
+T3_WIDGET_API signals::connection watch_fd(int fd, int events,
+                                           const signals::slot<void, int> &slot);
+
+/** Call a function from the main loop after a specified time.
+    @param msec The number of milliseconds to wait before calling @p slot.
+    @param repeat Boolean indicating whether @p slot should be called every @p msec milliseconds,
+        instead of only once.
+    @param slot The callback to call when the timer expires.
+    @return A connection which can be used to cancel the timer.
+
+    Like for #watch_fd, @p slot is called from the thread running #main_loop.
+    Timers do not catch up on missed expiries: if the main loop is busy for
+    longer than @p msec milliseconds, a repeating timer is called only once.
+*/
+T3_WIDGET_API signals::connection add_timer(int msec, bool repeat, const signals::slot<void> &slot);
+
 /** Free memory used by libt3widget.
     After this function is called, no further calls to libt3widget should be
     made. Normally, there is no reason to call this function at all, because the
@@ -45,7 +45,7 @@ bool use_xterm_mouse_reporting() { return xterm_mouse_reporting != XTERM_MOUSE_N
 
 #define ensure_buffer_fill()                             \
   do {                                                   \
-    while (char_buffer_fill == idx) {                    \
+    while (char_buffer.size() == idx) {                  \
       if (!read_keychar(1)) {                            \
         xterm_mouse_reporting = XTERM_MOUSE_SINGLE_BYTE; \
         goto convert_mouse_event;                        \
@@ -107,11 +107,11 @@ static bool convert_x10_mouse_event(int x, int y, int buttons) {
 
   event.window = nullptr;
   event.modifier_state = (buttons >> 2) & 7;
-  mouse_event_buffer.push_back(event);
-  return true;
+  event.count = 1;
+  return mouse_event_buffer.push_back_merged(event);
 }
 
-static void convert_sgr_mouse_event(int x, int y, int buttons, char closing_char) {
+static bool convert_sgr_mouse_event(int x, int y, int buttons, char closing_char) {
   mouse_event_t event;
   event.x = x - 1;
   event.y = y - 1;
@@ -168,7 +168,16 @@ static void convert_sgr_mouse_event(int x, int y, int buttons, char closing_char
   }
   event.window = nullptr;
   event.modifier_state = (buttons >> 2) & 7;
-  mouse_event_buffer.push_back(event);
+  event.count = 1;
+  return mouse_event_buffer.push_back_merged(event);
+}
+
+void inject_mouse_event(mouse_event_t event) {
+  event.previous_button_state = mouse_button_state;
+  mouse_button_state = event.button_state & ~(EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN);
+  event.window = nullptr;
+  event.count = 1;
+  if (mouse_event_buffer.push_back_merged(event)) inject_key(EKEY_MOUSE_EVENT);
 }
 
 /** Decode an XTerm mouse event.
@@ -206,7 +215,7 @@ static void convert_sgr_mouse_event(int x, int y, int buttons, char closing_char
 bool decode_xterm_mouse() {
   int x, y, buttons, idx, i;
 
-  while (char_buffer_fill < 3) {
+  while (char_buffer.size() < 3) {
     if (!read_keychar(1)) return false;
   }
 
@@ -259,8 +268,7 @@ convert_mouse_event:
     default:
       return false;
   }
-  char_buffer_fill -= idx;
-  memmove(char_buffer, char_buffer + idx, char_buffer_fill);
+  char_buffer.erase_front(idx);
 
   return convert_x10_mouse_event(x, y, buttons);
 }
@@ -300,8 +308,7 @@ bool decode_xterm_mouse_sgr_urxvt(const key_t *data, size_t len) {
       }
 
       if (sgr_mode) {
-        convert_sgr_mouse_event(x, y, buttons, data[idx]);
-        return true;
+        return convert_sgr_mouse_event(x, y, buttons, data[idx]);
       } else if (data[idx] == 'm') {
         return false;
       } else {
@@ -356,8 +363,8 @@ static bool process_gpm_event() {
   if (gpm_event.modifiers & ((1 << KG_ALT) | (1 << KG_ALTGR)))
     mouse_event.modifier_state |= EMOUSE_META;
   if (gpm_event.modifiers & (1 << KG_CTRL)) mouse_event.modifier_state |= EMOUSE_CTRL;
-  mouse_event_buffer.push_back(mouse_event);
-  return true;
+  mouse_event.count = 1;
+  return mouse_event_buffer.push_back_merged(mouse_event);
 }
 #endif
 
@@ -378,7 +385,7 @@ void init_mouse_reporting(bool xterm_mouse) {
     connect.maxMod = ~0;
 
     if (Gpm_Open(&connect, 0) >= 0) {
-      lprintf("Socket opened successfully\n");
+      lcprintf(LOG_INPUT, LOG_INFO, "Socket opened successfully\n");
       use_gpm = true;
     }
   }
@@ -400,6 +407,21 @@ void stop_mouse_reporting() {
 #endif
 }
 
+#ifdef HAS_EPOLL
+int get_mouse_fd() {
+#if defined(HAS_GPM)
+  if (use_gpm) return gpm_fd;
+#endif
+  return -1;
+}
+
+bool process_mouse_fd() {
+#if defined(HAS_GPM)
+  if (use_gpm) return process_gpm_event();
+#endif
+  return false;
+}
+#else
 void fd_set_mouse_fd(fd_set *readset, int *max_fd) {
 #if defined(HAS_GPM)
   if (use_gpm) {
@@ -421,5 +443,6 @@ bool check_mouse_fd(fd_set *readset) {
 #endif
   return false;
 }
+#endif
 
 };  // namespace
@@ -23,6 +23,14 @@ namespace t3_widget {
 struct mouse_event_t {
   t3_window_t *window;
   short type, x, y, previous_button_state, button_state, modifier_state;
+  /** Number of events merged into this event.
+
+      Consecutive motion events with the same button and modifier state are reported as a
+      single motion event to the last location, and consecutive scroll wheel events in the same
+      direction at the same location as a single event. For scroll wheel events, this is the
+      number of scroll steps the event represents.
+  */
+  short count;
 };
 
 enum {
@@ -11,6 +11,7 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
 #include <climits>
 #include <cstring>
 #include <new>
@@ -39,6 +40,7 @@ text_buffer_t::text_buffer_t(text_line_factory_t *_line_factory)
     : impl(new implementation_t(_line_factory)), cursor(0, 0) {
   /* Allocate a new, empty line */
   impl->lines.push_back(impl->line_factory->new_text_line_t());
+  connect_rewrap_required(signals::mem_fun(this, &text_buffer_t::lines_changed));
 }
 
 text_buffer_t::~text_buffer_t() {
@@ -102,6 +104,23 @@ bool text_buffer_t::backspace_char() {
 
 bool text_buffer_t::is_modified() const { return !impl->undo_list.is_at_mark(); }
 
+text_buffer_t::stats_t text_buffer_t::get_stats() const {
+  stats_t stats;
+  size_t line_bytes = impl->lines.capacity() * sizeof(text_line_t *);
+
+  stats.lines = impl->lines.size();
+  stats.text_bytes = 0;
+  for (const text_line_t *line : impl->lines) {
+    stats.text_bytes += line->get_length();
+    line_bytes += line->get_memory_usage();
+  }
+  stats.line_overhead = line_bytes - stats.text_bytes;
+  stats.undo_records = impl->undo_list.get_size();
+  stats.undo_bytes = impl->undo_list.get_memory_usage();
+  stats.last_find_time = impl->last_find_time;
+  return stats;
+}
+
 bool text_buffer_t::merge_internal(int line) {
   cursor.line = line;
   cursor.pos = impl->lines[line]->get_length();
@@ -144,18 +163,18 @@ bool text_buffer_t::break_line_internal(const std::string *indent) {
   text_line_t *insert;
 
   insert = impl->lines[cursor.line]->break_line(cursor.pos);
+  /* Add the indent before signalling the change, such that the receivers see the new line as it
+     will be. */
+  if (indent != nullptr) {
+    text_line_t *new_line = impl->line_factory->new_text_line_t(indent);
+    new_line->merge(insert);
+    insert = new_line;
+  }
   impl->lines.insert(impl->lines.begin() + cursor.line + 1, insert);
   rewrap_required(rewrap_type_t::REWRAP_LINE, cursor.line, cursor.pos);
   rewrap_required(rewrap_type_t::INSERT_LINES, cursor.line + 1, cursor.line + 2);
   cursor.line++;
-  if (indent == nullptr) {
-    cursor.pos = 0;
-  } else {
-    text_line_t *new_line = impl->line_factory->new_text_line_t(indent);
-    new_line->merge(impl->lines[cursor.line]);
-    impl->lines[cursor.line] = new_line;
-    cursor.pos = indent->size();
-  }
+  cursor.pos = indent == nullptr ? 0 : indent->size();
   return true;
 }
 
@@ -181,7 +200,201 @@ int text_buffer_t::calculate_line_pos(int line, int pos, int tabsize) const {
 
 void text_buffer_t::paint_line(t3_window_t *win, int line, const text_line_t::paint_info_t *info) {
   prepare_paint_line(line);
-  impl->lines[line]->paint_line(win, info);
+  if (impl->highlighter == nullptr) {
+    impl->lines[line]->paint_line(win, info);
+    return;
+  }
+
+  /* With line wrapping, a line is painted in several parts. Only highlight it once. */
+  if (impl->highlight_runs_line != line) {
+    int state = get_highlight_state(line);
+    impl->highlight_runs.clear();
+    impl->highlighter->highlight_line(impl->lines[line], state, &impl->highlight_runs);
+    impl->highlight_runs_line = line;
+  }
+  impl->lines[line]->paint_line(win, info, &impl->highlight_runs);
+}
+
+void text_buffer_t::save_view_state(view_state_t *view) const {
+  view->cursor = cursor;
+  view->selection_start = impl->selection_start;
+  view->selection_end = impl->selection_end;
+  view->selection_mode = impl->selection_mode;
+}
+
+/* Restore the state of a view. The text may have been edited through other views in the
+   meantime, so the coordinates are limited to the current contents. */
+void text_buffer_t::load_view_state(const view_state_t *view) {
+  auto clamp = [this](text_coordinate_t coord) {
+    if (coord.line < 0) return coord;
+    coord.line = std::min(coord.line, (int)impl->lines.size() - 1);
+    coord.pos = std::min(coord.pos, impl->lines[coord.line]->get_length());
+    coord.pos = impl->lines[coord.line]->adjust_position(coord.pos, 0);
+    return coord;
+  };
+  cursor = clamp(view->cursor);
+  impl->selection_start = clamp(view->selection_start);
+  impl->selection_end = clamp(view->selection_end);
+  impl->selection_mode = view->selection_mode;
+}
+
+void text_buffer_t::activate_view(const std::shared_ptr<view_state_t> &view) {
+  std::shared_ptr<view_state_t> active = impl->active_view.lock();
+  if (active == view) return;
+
+  if (active != nullptr) save_view_state(active.get());
+  impl->active_view = view;
+
+  for (const std::weak_ptr<view_state_t> &known_view : impl->views) {
+    if (known_view.lock() == view) {
+      load_view_state(view.get());
+      return;
+    }
+  }
+
+  /* A new view starts with the current state. Purge the views which no longer exist while
+     registering it. */
+  impl->views.erase(std::remove_if(impl->views.begin(), impl->views.end(),
+                                   [](const std::weak_ptr<view_state_t> &known_view) {
+                                     return known_view.expired();
+                                   }),
+                    impl->views.end());
+  impl->views.push_back(view);
+  save_view_state(view.get());
+}
+
+/* Mark the inactive views as changed, and keep their line numbers pointing at the same text when
+   lines are inserted or deleted. Positions within lines are only validated when the view is
+   activated again. */
+void text_buffer_t::adjust_views(rewrap_type_t type, int a, int b) {
+  if (impl->views.size() < 2) return;
+
+  std::shared_ptr<view_state_t> active = impl->active_view.lock();
+  bool lines_moved = type == rewrap_type_t::INSERT_LINES || type == rewrap_type_t::DELETE_LINES;
+  /* Returns true if the line of @p coord was deleted. */
+  auto adjust = [type, a, b](text_coordinate_t *coord) {
+    if (coord->line < a) return false;
+    if (type == rewrap_type_t::INSERT_LINES) {
+      coord->line += b - a;
+    } else if (coord->line >= b) {
+      coord->line -= b - a;
+    } else {
+      coord->line = std::max(a - 1, 0);
+      return true;
+    }
+    return false;
+  };
+
+  for (const std::weak_ptr<view_state_t> &known_view : impl->views) {
+    std::shared_ptr<view_state_t> view = known_view.lock();
+    if (view == nullptr || view == active) continue;
+    view->changed = true;
+    if (!lines_moved) continue;
+    adjust(&view->cursor);
+    adjust(&view->selection_start);
+    adjust(&view->selection_end);
+    if (adjust(&view->top_left)) view->top_left.pos = 0;
+  }
+}
+
+void text_buffer_t::set_highlighter(highlighter_t *highlighter) {
+  impl->highlighter = highlighter;
+  impl->highlight_states.clear();
+  impl->highlight_runs.clear();
+  impl->highlight_runs_line = -1;
+  impl->highlight_valid = 0;
+  impl->highlight_changed_end = 0;
+  if (highlighter == nullptr) return;
+  /* The stored states are only used to detect that highlighting has converged to the state
+     before an edit. Use -1 to indicate that there is no valid state yet. */
+  impl->highlight_states.resize(impl->lines.size(), -1);
+  impl->highlight_changed_end = impl->lines.size();
+}
+
+highlighter_t *text_buffer_t::get_highlighter() const { return impl->highlighter; }
+
+int text_buffer_t::get_highlight_state(int line) {
+  if (impl->highlighter == nullptr) return 0;
+  update_highlight_states(line);
+  return line == 0 ? impl->highlighter->get_initial_state() : impl->highlight_states[line - 1];
+}
+
+/* Make sure the end states of the lines before @p line are valid. */
+void text_buffer_t::update_highlight_states(int line) {
+  text_line_t::attr_runs_t runs;
+
+  while (impl->highlight_valid < line) {
+    int idx = impl->highlight_valid;
+    int state = idx == 0 ? impl->highlighter->get_initial_state() : impl->highlight_states[idx - 1];
+    runs.clear();
+    state = impl->highlighter->highlight_line(impl->lines[idx], state, &runs);
+    bool converged = idx >= impl->highlight_changed_end && impl->highlight_states[idx] == state;
+    impl->highlight_states[idx] = state;
+    impl->highlight_valid++;
+    /* If this line was not modified and ends in the same state as before, all subsequent
+       lines will also end in the same state, so no further work is necessary. */
+    if (converged) {
+      impl->highlight_valid = impl->highlight_states.size();
+      impl->highlight_changed_end = 0;
+    }
+  }
+}
+
+void text_buffer_t::lines_changed(rewrap_type_t type, int a, int b) {
+  adjust_views(type, a, b);
+  invalidate_highlight(type, a, b);
+
+  switch (type) {
+    case rewrap_type_t::REWRAP_ALL:
+      lines_edited(0, impl->lines.size(), impl->lines.size());
+      break;
+    case rewrap_type_t::REWRAP_LINE:
+    case rewrap_type_t::REWRAP_LINE_LOCAL:
+      lines_edited(a, 1, 1);
+      break;
+    case rewrap_type_t::INSERT_LINES:
+      lines_edited(a, 0, b - a);
+      break;
+    case rewrap_type_t::DELETE_LINES:
+      lines_edited(a, b - a, 0);
+      break;
+    default:
+      break;
+  }
+}
+
+void text_buffer_t::invalidate_highlight(rewrap_type_t type, int a, int b) {
+  if (impl->highlighter == nullptr) return;
+
+  impl->highlight_runs_line = -1;
+  switch (type) {
+    case rewrap_type_t::REWRAP_ALL:
+      impl->highlight_valid = 0;
+      impl->highlight_changed_end = impl->highlight_states.size();
+      return;
+    case rewrap_type_t::REWRAP_LINE:
+    case rewrap_type_t::REWRAP_LINE_LOCAL:
+      b = a + 1;
+      break;
+    case rewrap_type_t::INSERT_LINES:
+      impl->highlight_states.insert(impl->highlight_states.begin() + a, b - a, -1);
+      if (impl->highlight_changed_end > a) impl->highlight_changed_end += b - a;
+      break;
+    case rewrap_type_t::DELETE_LINES:
+      impl->highlight_states.erase(impl->highlight_states.begin() + a,
+                                   impl->highlight_states.begin() + b);
+      if (impl->highlight_changed_end > b)
+        impl->highlight_changed_end -= b - a;
+      else if (impl->highlight_changed_end > a)
+        impl->highlight_changed_end = a;
+      /* Only the start state of the line following the deleted lines has changed. */
+      b = a;
+      break;
+    default:
+      ASSERT(false);
+  }
+  impl->highlight_valid = std::min(impl->highlight_valid, a);
+  impl->highlight_changed_end = std::max(impl->highlight_changed_end, b);
 }
 
 int text_buffer_t::get_line_max(int line) const { return impl->lines[line]->get_length(); }
@@ -698,6 +911,8 @@ void text_buffer_t::set_selection_from_find(find_result_t *result) {
 }
 
 bool text_buffer_t::find(finder_t *finder, find_result_t *result, bool reverse) const {
+  scoped_timer_t timer(&impl->last_find_time);
+  trace_scope_t trace("text_buffer_t::find");
   size_t start, idx;
 
   /* Note: the value of result->start.line and result->end.line are ignored after the
@@ -764,6 +979,8 @@ bool text_buffer_t::find(finder_t *finder, find_result_t *result, bool reverse)
 
 bool text_buffer_t::find_limited(finder_t *finder, text_coordinate_t start, text_coordinate_t end,
                                  find_result_t *result) const {
+  scoped_timer_t timer(&impl->last_find_time);
+  trace_scope_t trace("text_buffer_t::find_limited");
   size_t idx;
 
   /* Note: the finder->match function does not take value of result->start.line
@@ -14,10 +14,13 @@
 #ifndef T3_WIDGET_TEXTBUFFER_H
 #define T3_WIDGET_TEXTBUFFER_H
 
+#include <chrono>
 #include <cstdio>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <t3widget/highlighter.h>
 #include <t3widget/interfaces.h>
 #include <t3widget/key.h>
 #include <t3widget/textline.h>
@@ -34,6 +37,47 @@ class wrap_info_t;
 class T3_WIDGET_API text_buffer_t {
   friend class wrap_info_t;
 
+ public:
+  /** Cursor, selection and scroll position of a single view on a text_buffer_t.
+
+      Multiple views can display the same text_buffer_t, each with their own cursor and
+      selection. The text_buffer_t only holds the state of the active view, in @c cursor and
+      the selection members. Views must call activate_view before operating on the
+      text_buffer_t. A view that is activated for the first time starts with a copy of the
+      state of the active view.
+
+      The @c top_left and @c changed members are maintained by the view itself, except that
+      while the view is inactive, the line of @c top_left is kept pointing at the same text and
+      @c changed is set when the text is edited.
+  */
+  struct T3_WIDGET_API view_state_t {
+    text_coordinate_t cursor;
+    text_coordinate_t selection_start;
+    text_coordinate_t selection_end;
+    selection_mode_t selection_mode;
+    text_coordinate_t top_left;
+    bool changed;
+
+    view_state_t()
+        : cursor(0, 0),
+          selection_start(-1, 0),
+          selection_end(-1, 0),
+          selection_mode(selection_mode_t::NONE),
+          top_left(0, 0),
+          changed(false) {}
+  };
+
+  /** Statistics about the contents and memory use of a text_buffer_t, as returned by
+      #get_stats. All sizes are in bytes. */
+  struct T3_WIDGET_API stats_t {
+    size_t lines;          /**< Number of lines. */
+    size_t text_bytes;     /**< Size of the text, excluding line separators. */
+    size_t line_overhead;  /**< Memory used to store the lines, in addition to the text itself. */
+    size_t undo_records;   /**< Number of undo records. */
+    size_t undo_bytes;     /**< Memory used by the undo records. */
+    std::chrono::nanoseconds last_find_time; /**< Duration of the last find operation. */
+  };
+
  private:
   struct T3_WIDGET_LOCAL implementation_t {
     lines_t lines;
@@ -48,13 +92,35 @@ class T3_WIDGET_API text_buffer_t {
 
     text_line_factory_t *line_factory;
 
+    highlighter_t *highlighter;
+    /* End state of each line. Only the states of the lines before highlight_valid are known
+       to be correct. The lines from highlight_changed_end onwards have not been modified
+       since their state was computed. */
+    std::vector<int> highlight_states;
+    int highlight_valid, highlight_changed_end;
+    /* Cached attributes of the last painted line, or -1 if there is none. */
+    int highlight_runs_line;
+    text_line_t::attr_runs_t highlight_runs;
+
+    /* All views which have been activated, and the currently active one. The views are owned
+       by their users, so the text_buffer_t only keeps weak references. */
+    std::vector<std::weak_ptr<view_state_t>> views;
+    std::weak_ptr<view_state_t> active_view;
+
+    std::chrono::nanoseconds last_find_time;
+
     implementation_t(text_line_factory_t *_line_factory)
         : selection_start(-1, 0),
           selection_end(-1, 0),
           selection_mode(selection_mode_t::NONE),
           last_undo_type(UNDO_NONE),
           last_undo(NULL),
-          line_factory(_line_factory == NULL ? &default_text_line_factory : _line_factory) {}
+          line_factory(_line_factory == NULL ? &default_text_line_factory : _line_factory),
+          highlighter(NULL),
+          highlight_valid(0),
+          highlight_changed_end(0),
+          highlight_runs_line(-1),
+          last_find_time(0) {}
   };
   pimpl_ptr<implementation_t>::t impl;
 
@@ -73,6 +139,13 @@ class T3_WIDGET_API text_buffer_t {
 
   bool undo_indent_selection(undo_t *undo, undo_type_t type);
 
+  void lines_changed(rewrap_type_t type, int a, int b);
+  void invalidate_highlight(rewrap_type_t type, int a, int b);
+  void adjust_views(rewrap_type_t type, int a, int b);
+  void save_view_state(view_state_t *view) const;
+  void load_view_state(const view_state_t *view);
+  void update_highlight_states(int line);
+
   text_line_t *get_line_data_nonconst(int idx);
   text_line_factory_t *get_line_factory();
 
@@ -102,6 +175,26 @@ class T3_WIDGET_API text_buffer_t {
   int width_at_cursor() const;
 
   void paint_line(t3_window_t *win, int line, const text_line_t::paint_info_t *info);
+
+  /** Make @p view the active view.
+
+      The state of the previously active view is saved, and the state of @p view is
+      restored into @c cursor and the selection. Line numbers of inactive views are kept up
+      to date when lines are inserted or deleted, and their @c changed member is set on every
+      edit.
+  */
+  void activate_view(const std::shared_ptr<view_state_t> &view);
+
+  /** Set the highlighter used to determine the attributes of the text.
+      @param highlighter The highlighter to use, or @c NULL to use text_line_t::get_base_attr.
+
+      The highlighter is not owned by the text_buffer_t, and must remain valid until it is
+      replaced or the text_buffer_t is destroyed.
+  */
+  void set_highlighter(highlighter_t *highlighter);
+  highlighter_t *get_highlighter() const;
+  /** Get the highlighter state at the start of a line. */
+  int get_highlight_state(int line);
   void goto_next_word();
   void goto_previous_word();
 
@@ -139,6 +232,12 @@ class T3_WIDGET_API text_buffer_t {
   void replace(finder_t *finder, find_result_t *result);
 
   bool is_modified() const;
+  /** Get statistics about the contents and memory use of this text_buffer_t.
+
+      This iterates over all lines and undo records, so it should not be called for every
+      update of the screen.
+  */
+  stats_t get_stats() const;
   std::string *convert_block(text_coordinate_t start, text_coordinate_t end);
   int apply_undo();
   int apply_redo();
@@ -162,6 +261,18 @@ class T3_WIDGET_API text_buffer_t {
   text_coordinate_t cursor;
 
   T3_WIDGET_SIGNAL(rewrap_required, void, rewrap_type_t, int, int);
+  /** @fn signals::connection connect_lines_edited(const signals::slot<void, int, int, int> &_slot)
+      Connect a callback to the #lines_edited signal.
+  */
+  /** Signal emitted when the text has changed.
+
+      The arguments are the index of the first changed line, the number of lines in the changed
+      range before the change, and the number of lines in that range after the change. Lines
+      before the range are unchanged, and lines after it only changed their index. A single edit
+      may emit the signal several times. Each changed line also has a new generation, see
+      text_line_t::get_generation.
+  */
+  T3_WIDGET_SIGNAL(lines_edited, void, int, int, int);
 };
 
 };  // namespace
@@ -14,7 +14,13 @@
 /* _XOPEN_SOURCE is defined to enable wcswidth. */
 #define _XOPEN_SOURCE
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cstring>
+#include <mutex>
+#include <new>
+#include <typeinfo>
 #include <t3window/utf8.h>
 
 #include "colorscheme.h"
@@ -33,8 +39,17 @@ char text_line_t::dots[16];
 const char *text_line_t::control_map = "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]_^";
 const char *text_line_t::wrap_symbol = "\xE2\x86\xB5";
 
+/* Maximum number of bytes in a span of characters painted with the same attributes. */
+static const int max_draw_span = 256;
+
 text_line_factory_t default_text_line_factory;
 
+static std::atomic<uint64_t> last_generation(0);
+
+static uint64_t next_generation() {
+  return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 // Returns whether a codepoint is one of the conjoining Jamo L codepoints.
 static bool is_conjoining_jamo_l(uint32_t c) { return c >= 0x1100 && c <= 0x1112; }
 
@@ -54,6 +69,7 @@ static bool is_conjoining_jamo_lv(uint32_t c) {
 
 text_line_t::text_line_t(int buffersize, text_line_factory_t *_factory)
     : starts_with_combining(false),
+      generation(next_generation()),
       factory(_factory == nullptr ? &default_text_line_factory : _factory) {
   reserve(buffersize);
 }
@@ -83,33 +99,39 @@ void text_line_t::fill_line(const char *_buffer, int length) {
 
 text_line_t::text_line_t(const char *_buffer, text_line_factory_t *_factory)
     : starts_with_combining(false),
+      generation(next_generation()),
       factory(_factory == nullptr ? &default_text_line_factory : _factory) {
   fill_line(_buffer, strlen(_buffer));
 }
 
 text_line_t::text_line_t(const char *_buffer, int length, text_line_factory_t *_factory)
     : starts_with_combining(false),
+      generation(next_generation()),
       factory(_factory == nullptr ? &default_text_line_factory : _factory) {
   fill_line(_buffer, length);
 }
 
 text_line_t::text_line_t(const std::string *str, text_line_factory_t *_factory)
     : starts_with_combining(false),
+      generation(next_generation()),
       factory(_factory == nullptr ? &default_text_line_factory : _factory) {
   fill_line(str->data(), str->size());
 }
 
 void text_line_t::set_text(const char *_buffer) {
+  generation = next_generation();
   buffer.clear();
   fill_line(_buffer, strlen(_buffer));
 }
 
 void text_line_t::set_text(const char *_buffer, size_t length) {
+  generation = next_generation();
   buffer.clear();
   fill_line(_buffer, length);
 }
 
 void text_line_t::set_text(const std::string *str) {
+  generation = next_generation();
   buffer.clear();
   fill_line(str->data(), str->size());
 }
@@ -123,6 +145,7 @@ void text_line_t::merge(text_line_t *other) {
   reserve(buffer.size() + other->buffer.size());
 
   buffer += other->buffer;
+  generation = next_generation();
   delete other;
 }
 
@@ -144,6 +167,7 @@ text_line_t *text_line_t::break_line(int pos) {
   newline->buffer.assign(buffer.data() + pos, buffer.size() - pos);
 
   buffer.resize(pos);
+  generation = next_generation();
   return newline;
 }
 
@@ -159,6 +183,7 @@ text_line_t *text_line_t::cut_line(int start, int end) {
 
   buffer.erase(start, end - start);
   starts_with_combining = buffer.size() > 0 && width_at(0) == 0;
+  generation = next_generation();
 
   return retval;
 }
@@ -202,6 +227,7 @@ void text_line_t::insert(text_line_t *other, int pos) {
   reserve(buffer.size() + other->buffer.size());
   buffer.insert(pos, other->buffer);
   if (pos == 0) starts_with_combining = other->starts_with_combining;
+  generation = next_generation();
 }
 
 void text_line_t::minimize() {
@@ -269,27 +295,84 @@ t3_attr_t text_line_t::get_base_attr(int i, const text_line_t::paint_info_t *inf
   return info->normal_attr;
 }
 
-t3_attr_t text_line_t::get_draw_attrs(int i, const text_line_t::paint_info_t *info) {
-  t3_attr_t retval = get_base_attr(i, info);
+t3_attr_t text_line_t::get_draw_attrs(int i, const text_line_t::paint_info_t *info,
+                                      draw_attrs_cache_t *cache) {
+  t3_attr_t base_attr;
+  int next_boundary = INT_MAX;
+  int size = buffer.size();
 
-  if (i >= info->selection_start && i < info->selection_end)
-    retval = i == info->cursor ? t3_term_combine_attrs(attributes.text_selection_cursor2, retval)
-                               : info->selected_attr;
-  else if (i == info->cursor)
-    retval = t3_term_combine_attrs(
-        i == info->selection_end ? attributes.text_selection_cursor : attributes.text_cursor,
-        retval);
+  if (cache->highlight == nullptr) {
+    base_attr = cache->base_per_char ? get_base_attr(i, info) : info->normal_attr;
+  } else {
+    const attr_runs_t &runs = *cache->highlight;
+    if (i < cache->start) {
+      cache->run = 0;
+      cache->end = 0;
+    }
+    if (cache->end == 0 || (cache->run < runs.size() && runs[cache->run].end <= i)) {
+      while (cache->run < runs.size() && runs[cache->run].end <= i) cache->run++;
+      cache->run_attr = cache->run < runs.size()
+                            ? t3_term_combine_attrs(runs[cache->run].attr, info->normal_attr)
+                            : info->normal_attr;
+    }
+    base_attr = cache->run_attr;
+    if (cache->run < runs.size()) next_boundary = runs[cache->run].end;
+  }
 
-  if (is_bad_draw(i)) retval = t3_term_combine_attrs(attributes.bad_draw, retval);
+  if (i < cache->start || i >= cache->end || base_attr != cache->base_attr) {
+    t3_attr_t retval = base_attr;
+
+    if (i >= info->selection_start && i < info->selection_end)
+      retval = i == info->cursor ? t3_term_combine_attrs(attributes.text_selection_cursor2, retval)
+                                 : info->selected_attr;
+    else if (i == info->cursor)
+      retval = t3_term_combine_attrs(
+          i == info->selection_end ? attributes.text_selection_cursor : attributes.text_cursor,
+          retval);
+
+    const int boundaries[] = {
+        info->selection_start, info->selection_end, info->cursor,
+        info->cursor >= 0 && info->cursor < size ? adjust_position(info->cursor, 1)
+                                                 : info->cursor + 1};
+    for (int boundary : boundaries) {
+      if (boundary > i && boundary < next_boundary) next_boundary = boundary;
+    }
+    /* Limit the length of a span, such that painting the start of a very long line does not
+       check whether the whole line can be drawn. The span must end at a character with
+       non-zero width, or the combining characters before it would not be checked. */
+    if (next_boundary - i > max_draw_span && i + max_draw_span < size) {
+      next_boundary = i + max_draw_span;
+      while (next_boundary < size && (buffer[next_boundary] & 0xc0) == 0x80) next_boundary++;
+      while (next_boundary < size && width_at(next_boundary) == 0)
+        next_boundary += byte_width_from_first(next_boundary);
+    }
+    cache->start = i;
+    cache->end = next_boundary;
+    cache->base_attr = base_attr;
+    cache->attr = retval;
+    /* Only if the span as a whole can not be drawn, check the characters separately. */
+    int check_end = std::min(next_boundary, size);
+    cache->bad_draw = check_end > i && !t3_term_can_draw(buffer.data() + i, check_end - i);
+  }
 
-  return retval;
+  if (cache->bad_draw && is_bad_draw(i))
+    return t3_term_combine_attrs(attributes.bad_draw, cache->attr);
+  return cache->attr;
 }
 
 void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *info) {
+  paint_line(win, info, nullptr);
+}
+
+void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *info,
+                             const attr_runs_t *highlight) {
   int i, j, total = 0, print_from, tabspaces, accumulated = 0, endchars = 0;
   bool _is_print, new_is_print;
   t3_attr_t selection_attr = 0, new_selection_attr;
   int flags = info->flags, size = info->size;
+  /* Subclasses may override get_base_attr to use different attributes for each character. */
+  draw_attrs_cache_t attrs_cache(highlight,
+                                 highlight == nullptr && typeid(*this) != typeid(text_line_t));
 
   if (info->tabsize == 0) flags |= text_line_t::TAB_AS_CONTROL;
 
@@ -302,7 +385,8 @@ void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *
 
   for (i = info->start; (size_t)i < buffer.size() && i < info->max && total < info->leftcol;
        i += byte_width_from_first(i)) {
-    if (width_at(i) != 0) selection_attr = get_draw_attrs(i, info);
+    if (width_at(i) != 0 && !attrs_cache.covers(i))
+      selection_attr = get_draw_attrs(i, info, &attrs_cache);
 
     if (buffer[i] == '\t' && !(flags & text_line_t::TAB_AS_CONTROL)) {
       tabspaces = info->tabsize - (total % info->tabsize);
@@ -310,10 +394,10 @@ void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *
       if (total >= size) total = size;
       if (total > info->leftcol) {
         if (flags & text_line_t::SHOW_TABS) {
-          selection_attr = t3_term_combine_attrs(selection_attr, attributes.meta_text);
+          t3_attr_t tab_attr = t3_term_combine_attrs(selection_attr, attributes.meta_text);
           if (total - info->leftcol > 1)
-            t3_win_addnstr(win, dashes, total - info->leftcol - 1, selection_attr);
-          t3_win_addch(win, '>', selection_attr);
+            t3_win_addnstr(win, dashes, total - info->leftcol - 1, tab_attr);
+          t3_win_addch(win, '>', tab_attr);
         } else {
           t3_win_addnstr(win, spaces, total - info->leftcol, selection_attr);
         }
@@ -336,7 +420,7 @@ void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *
   }
 
   if (starts_with_combining && info->leftcol == 0 && info->start == 0) {
-    selection_attr = get_draw_attrs(0, info);
+    selection_attr = get_draw_attrs(0, info, &attrs_cache);
     paint_part(win, " ", true, 1, t3_term_combine_attrs(attributes.non_print, selection_attr));
 
     print_from = i;
@@ -361,7 +445,8 @@ void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *
   new_selection_attr = selection_attr;
   for (; (size_t)i < buffer.size() && i < info->max && total + accumulated < size;
        i += byte_width_from_first(i)) {
-    if (width_at(i) != 0) new_selection_attr = get_draw_attrs(i, info);
+    if (width_at(i) != 0 && !attrs_cache.covers(i))
+      new_selection_attr = get_draw_attrs(i, info, &attrs_cache);
 
     /* If selection changed between this char and the previous, print what
        we had so far. */
@@ -451,7 +536,7 @@ void text_line_t::paint_line(t3_window_t *win, const text_line_t::paint_info_t *
      and this line is not merely a part of a broken line */
   if (total < size && !(flags & text_line_t::BREAK)) {
     if (i <= info->selection_end || i == info->cursor) {
-      t3_win_addch(win, ' ', get_draw_attrs(i, info));
+      t3_win_addch(win, ' ', get_draw_attrs(i, info, &attrs_cache));
       total++;
     }
   }
@@ -619,6 +704,7 @@ bool text_line_t::insert_char(int pos, key_t c, undo_t *undo) {
   if (pos == 0) starts_with_combining = key_width(c) == 0;
 
   buffer.insert(pos, conversion_buffer, conversion_length);
+  generation = next_generation();
   return true;
 }
 
@@ -662,6 +748,7 @@ bool text_line_t::overwrite_char(int pos, key_t c, undo_t *undo) {
   }
 
   buffer.replace(pos, oldspace, conversion_buffer, conversion_length);
+  generation = next_generation();
   return true;
 }
 
@@ -685,6 +772,7 @@ bool text_line_t::delete_char(int pos, undo_t *undo) {
   }
 
   buffer.erase(pos, oldspace);
+  generation = next_generation();
   return true;
 }
 
@@ -786,6 +874,10 @@ bool text_line_t::is_bad_draw(int pos) const {
 
 const std::string *text_line_t::get_data() const { return &buffer; }
 
+size_t text_line_t::get_memory_usage() const { return sizeof(*this) + string_heap_usage(buffer); }
+
+uint64_t text_line_t::get_generation() const { return generation; }
+
 void text_line_t::init() {
   memset(spaces, ' ', sizeof(spaces));
   memset(dashes, '-', sizeof(dashes));
@@ -803,6 +895,69 @@ bool text_line_t::check_boundaries(int match_start, int match_end) const {
           get_class(&buffer, match_end) != get_class(&buffer, adjust_position(match_end, 1)));
 }
 
+/* Pool of fixed size slots for text_line_t objects. Memory is obtained in slabs of many slots
+   at a time. Released slots are kept on a free list for reuse, and are never returned to the
+   system. The pool itself is never destroyed, because lines may still be deleted by the
+   destructors of other static objects. */
+namespace {
+class line_pool_t {
+ public:
+  line_pool_t() : free_list(nullptr) {}
+
+  void *allocate() {
+    std::unique_lock<std::mutex> l(lock);
+    if (free_list == nullptr) add_slab();
+    free_slot_t *result = free_list;
+    free_list = result->next;
+    return result;
+  }
+
+  void deallocate(void *ptr) {
+    std::unique_lock<std::mutex> l(lock);
+    free_slot_t *slot = static_cast<free_slot_t *>(ptr);
+    slot->next = free_list;
+    free_list = slot;
+  }
+
+ private:
+  struct free_slot_t {
+    free_slot_t *next;
+  };
+  enum { SLAB_SLOTS = 1024 };
+
+  void add_slab() {
+    char *slab = static_cast<char *>(::operator new(SLAB_SLOTS * sizeof(text_line_t)));
+    for (size_t i = SLAB_SLOTS; i > 0; --i) {
+      free_slot_t *slot = reinterpret_cast<free_slot_t *>(slab + (i - 1) * sizeof(text_line_t));
+      slot->next = free_list;
+      free_list = slot;
+    }
+  }
+
+  std::mutex lock;
+  free_slot_t *free_list;
+};
+
+line_pool_t *get_line_pool() {
+  static line_pool_t *pool = new line_pool_t();
+  return pool;
+}
+}  // namespace
+
+void *text_line_t::operator new(size_t size) {
+  if (size != sizeof(text_line_t)) return ::operator new(size);
+  return get_line_pool()->allocate();
+}
+
+void text_line_t::operator delete(void *ptr, size_t size) {
+  if (ptr == nullptr) return;
+  if (size != sizeof(text_line_t)) {
+    ::operator delete(ptr);
+    return;
+  }
+  get_line_pool()->deallocate(ptr);
+}
+
 //============================= text_line_factory_t ========================
 
 text_line_factory_t::text_line_factory_t() {}
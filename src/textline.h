@@ -17,10 +17,12 @@
 #define BUFFERSIZE 64
 #define BUFFERINC 16
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <sys/types.h>
 #include <t3window/window.h>
+#include <vector>
 
 #include <t3widget/key.h>
 #include <t3widget/widget_api.h>
@@ -61,6 +63,14 @@ class T3_WIDGET_API text_line_t {
                                            // string highlighting;
   };
 
+  /** Attribute for a range of bytes in the line, as produced by a highlighter_t. The range
+      starts at the end of the previous run (or the start of the line) and ends at @c end. */
+  struct T3_WIDGET_API attr_run_t {
+    int end;
+    t3_attr_t attr;
+  };
+  typedef std::vector<attr_run_t> attr_runs_t;
+
   struct T3_WIDGET_API break_pos_t {
     int pos;
     int flags;
@@ -69,6 +79,7 @@ class T3_WIDGET_API text_line_t {
  private:
   std::string buffer;
   bool starts_with_combining;
+  uint64_t generation;
 
  protected:
   text_line_factory_t *factory;
@@ -84,7 +95,39 @@ class T3_WIDGET_API text_line_t {
                          t3_attr_t selection_attr);
   static int key_width(key_t key);
 
-  t3_attr_t get_draw_attrs(int i, const text_line_t::paint_info_t *info);
+  /* State for computing the drawing attributes of consecutive characters in paint_line. The
+     attribute is computed once for each span of characters between selection, cursor and
+     highlighting boundaries, and paint_line only calls get_draw_attrs when a character is not
+     covered by the current span. */
+  struct T3_WIDGET_LOCAL draw_attrs_cache_t {
+    const attr_runs_t *highlight;
+    size_t run;           // Index of the highlighting run containing the last position.
+    t3_attr_t run_attr;   // Base attribute for the highlighting run.
+    t3_attr_t base_attr;  // Base attribute from which attr was computed.
+    int start, end;       // Range of positions for which attr is valid.
+    t3_attr_t attr;
+    /* Set if get_base_attr must be called for each character, because it may be overridden. */
+    bool base_per_char;
+    /* Set if the span contains characters which can not be drawn, and thus need bad_draw. */
+    bool bad_draw;
+
+    draw_attrs_cache_t(const attr_runs_t *_highlight, bool _base_per_char)
+        : highlight(_highlight),
+          run(0),
+          run_attr(0),
+          base_attr(0),
+          start(0),
+          end(0),
+          attr(0),
+          base_per_char(_base_per_char),
+          bad_draw(false) {}
+
+    /* Check whether attr is the attribute for the character at position @p i. */
+    bool covers(int i) const { return i >= start && i < end && !base_per_char && !bad_draw; }
+  };
+
+  t3_attr_t get_draw_attrs(int i, const text_line_t::paint_info_t *info,
+                           draw_attrs_cache_t *cache);
 
   void fill_line(const char *_buffer, int length);
   bool check_boundaries(int match_start, int match_end) const;
@@ -95,7 +138,12 @@ class T3_WIDGET_API text_line_t {
   int byte_width_from_first(int pos) const;
 
  public:
-  text_line_t(int buffersize = BUFFERSIZE, text_line_factory_t *_factory = NULL);
+  /** Create a new empty line, with room for @p buffersize bytes.
+
+      Short lines are stored inside the object itself, so by default no separate buffer is
+      allocated until the line grows.
+  */
+  text_line_t(int buffersize = 0, text_line_factory_t *_factory = NULL);
   text_line_t(const char *_buffer, text_line_factory_t *_factory = NULL);
   text_line_t(const char *_buffer, int length, text_line_factory_t *_factory = NULL);
   text_line_t(const std::string *str, text_line_factory_t *_factory = NULL);
@@ -118,6 +166,8 @@ class T3_WIDGET_API text_line_t {
   int calculate_line_pos(int start, int max, int pos, int tabsize) const;
 
   void paint_line(t3_window_t *win, const paint_info_t *info);
+  /** Paint the line, using the attributes in @p highlight instead of get_base_attr. */
+  void paint_line(t3_window_t *win, const paint_info_t *info, const attr_runs_t *highlight);
 
   break_pos_t find_next_break_pos(int start, int length, int tabsize) const;
   int get_next_word(int start) const;
@@ -139,12 +189,28 @@ class T3_WIDGET_API text_line_t {
   bool is_bad_draw(int pos) const;
 
   const std::string *get_data() const;
+  /** Get the number of bytes of memory used by this line, including the object itself. */
+  size_t get_memory_usage() const;
+  /** Get the generation of the line.
+
+      Every line is assigned a new generation when it is created and each time its text changes.
+      Generations are taken from a single increasing counter, so a cache of data derived from a
+      line can check whether it is still valid by comparing the generation.
+  */
+  uint64_t get_generation() const;
 
   int get_next_word_boundary(int start) const;
   int get_previous_word_boundary(int start) const;
 
   static void init();
 
+  /* Objects of exactly this class are allocated from a pool of fixed size slots, which avoids
+     the per-allocation overhead of the general purpose allocator for the many small objects
+     that make up a text. Objects of derived classes with a different size use the global
+     operator new. */
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
  protected:
   virtual t3_attr_t get_base_attr(int i, const paint_info_t *info);
 };
@@ -153,7 +219,7 @@ class T3_WIDGET_API text_line_factory_t {
  public:
   text_line_factory_t();
   virtual ~text_line_factory_t();
-  virtual text_line_t *new_text_line_t(int buffersize = BUFFERSIZE);
+  virtual text_line_t *new_text_line_t(int buffersize = 0);
   virtual text_line_t *new_text_line_t(const char *_buffer);
   virtual text_line_t *new_text_line_t(const char *_buffer, int length);
   virtual text_line_t *new_text_line_t(const std::string *str);
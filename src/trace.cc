@@ -0,0 +1,211 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <semaphore.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "internal.h"
+#include "log.h"
+#include "trace.h"
+
+namespace t3_widget {
+
+std::atomic<bool> trace_enabled(false);
+
+namespace {
+
+/* A single event in the ring buffer. As events may be written by one thread while being read by
+   another, the sequence member is used as a sequence lock: it is odd while the event is written,
+   and afterwards holds an even value derived from the index of the event. Readers only use an
+   event if the sequence number is the expected value both before and after reading it. */
+struct trace_event_t {
+  std::atomic<unsigned long long> sequence{0};
+  std::atomic<const char *> name{nullptr};
+  std::atomic<long long> start{0}, duration{0};
+  std::atomic<int> thread{0};
+};
+
+struct trace_buffer_t {
+  trace_buffer_t(size_t _size)
+      : events(new trace_event_t[_size]),
+        size(_size),
+        next_event(0),
+        epoch(std::chrono::steady_clock::now()) {}
+
+  std::unique_ptr<trace_event_t[]> events;
+  size_t size;
+  std::atomic<unsigned long long> next_event;
+  /* Time from which the start times of the events are measured. */
+  const std::chrono::steady_clock::time_point epoch;
+};
+
+std::atomic<trace_buffer_t *> trace_buffer{nullptr};
+/* Number of threads currently using the buffer pointed to by trace_buffer. A thread increments it
+   before loading trace_buffer, so once trace_buffer has been replaced, the old buffer is no longer
+   in use as soon as this is observed to be zero. This relies on the sequentially consistent
+   ordering of the operations on both variables. */
+std::atomic<int> trace_buffer_users{0};
+std::mutex trace_lock;
+
+std::atomic<int> next_thread_id{0};
+thread_local int thread_id = ++next_thread_id;
+
+sem_t write_requested;
+std::string signal_file_name;
+std::thread *write_thread;
+
+unsigned long long event_sequence(unsigned long long index) { return 2 * index + 2; }
+
+void record_event(trace_buffer_t *buffer, const char *name,
+                  std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end) {
+  unsigned long long index = buffer->next_event.fetch_add(1, std::memory_order_relaxed);
+  trace_event_t *event = &buffer->events[index % buffer->size];
+  event->sequence.store(event_sequence(index) - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event->name.store(name, std::memory_order_relaxed);
+  event->start.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(start - buffer->epoch).count(),
+      std::memory_order_relaxed);
+  event->duration.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+      std::memory_order_relaxed);
+  event->thread.store(thread_id, std::memory_order_relaxed);
+  event->sequence.store(event_sequence(index), std::memory_order_release);
+}
+
+void write_on_signal_thread() {
+  while (true) {
+    while (sem_wait(&write_requested) != 0 && errno == EINTR) {
+    }
+    std::string file_name;
+    {
+      std::unique_lock<std::mutex> l(trace_lock);
+      file_name = signal_file_name;
+    }
+    if (!trace_write(file_name.c_str())) {
+      lcprintf(LOG_GENERAL, LOG_ERROR, "Could not write trace to %s: %s\n", file_name.c_str(),
+               strerror(errno));
+    }
+  }
+}
+
+void write_signal_handler(int sig) {
+  int saved_errno = errno;
+  (void)sig;
+  sem_post(&write_requested);
+  errno = saved_errno;
+}
+
+}  // namespace
+
+void trace_record(const char *name, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end) {
+  trace_buffer_users++;
+  trace_buffer_t *buffer = trace_buffer.load();
+  if (buffer != nullptr) record_event(buffer, name, start, end);
+  trace_buffer_users--;
+}
+
+void trace_start(size_t max_events) {
+  std::unique_lock<std::mutex> l(trace_lock);
+  if (max_events == 0) max_events = 1;
+
+  /* Always use a new buffer: threads which passed the trace_enabled check before it was cleared
+     may still be recording events in the old one. */
+  trace_enabled = false;
+  std::unique_ptr<trace_buffer_t> old_buffer(trace_buffer.exchange(new trace_buffer_t(max_events)));
+  while (trace_buffer_users != 0) std::this_thread::yield();
+  old_buffer.reset();
+  trace_enabled = true;
+}
+
+void trace_stop() { trace_enabled = false; }
+
+bool trace_is_enabled() { return trace_enabled; }
+
+bool trace_write(const char *file_name) {
+  FILE *file;
+
+  if ((file = fopen(file_name, "w")) == nullptr) return false;
+
+  fprintf(file, "{\"traceEvents\": [");
+  trace_buffer_users++;
+  trace_buffer_t *buffer = trace_buffer.load();
+  if (buffer != nullptr) {
+    bool first = true;
+    int pid = getpid();
+    unsigned long long end = buffer->next_event.load(std::memory_order_relaxed);
+    unsigned long long begin = end > buffer->size ? end - buffer->size : 0;
+
+    for (unsigned long long index = begin; index < end; ++index) {
+      trace_event_t *event = &buffer->events[index % buffer->size];
+      unsigned long long sequence = event->sequence.load(std::memory_order_acquire);
+      if (sequence != event_sequence(index)) continue;
+      const char *name = event->name.load(std::memory_order_relaxed);
+      long long start = event->start.load(std::memory_order_relaxed);
+      long long duration = event->duration.load(std::memory_order_relaxed);
+      int thread = event->thread.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (event->sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+      /* The names are string literals from the library, which do not need escaping. */
+      fprintf(file,
+              "%s\n{\"name\": \"%s\", \"cat\": \"t3widget\", \"ph\": \"X\", \"pid\": %d, "
+              "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+              first ? "" : ",", name, pid, thread, start / 1000.0, duration / 1000.0);
+      first = false;
+    }
+  }
+  trace_buffer_users--;
+  fprintf(file, "\n], \"displayTimeUnit\": \"ns\"}\n");
+
+  if (ferror(file)) {
+    int saved_errno = errno;
+    fclose(file);
+    errno = saved_errno;
+    return false;
+  }
+  return fclose(file) == 0;
+}
+
+bool trace_write_on_signal(int signal_number, const char *file_name) {
+  struct sigaction sa;
+
+  {
+    std::unique_lock<std::mutex> l(trace_lock);
+    signal_file_name = file_name;
+    if (write_thread == nullptr) {
+      if (sem_init(&write_requested, 0, 0) != 0) return false;
+      write_thread = new std::thread(write_on_signal_thread);
+      write_thread->detach();
+    }
+  }
+
+  sa.sa_handler = write_signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  return sigaction(signal_number, &sa, nullptr) == 0;
+}
+
+};  // namespace
@@ -0,0 +1,66 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_TRACE_H
+#define T3_WIDGET_TRACE_H
+
+/** @file
+    Functions for tracing where time is spent in libt3widget.
+
+    The library contains trace points around the phases of the main loop (waiting for input,
+    handling input, updating the dialogs and updating the terminal), and around expensive
+    operations such as repainting an edit_window_t, rewrapping text, searching and clipboard
+    access. While tracing is enabled, each trace point records its start time and duration in a
+    fixed size ring buffer, such that only the most recent events are kept. The contents of the
+    ring buffer can be written in the Chrome trace event format, which can be viewed with
+    chrome://tracing or the Perfetto UI.
+
+    While tracing is disabled, a trace point costs a single load and compare.
+*/
+
+#include <cstddef>
+
+#include <t3widget/widget_api.h>
+
+namespace t3_widget {
+
+/** Start recording trace events.
+    @param max_events The number of events kept in the ring buffer.
+
+    Events recorded before a previous #trace_stop are discarded.
+*/
+T3_WIDGET_API void trace_start(size_t max_events = 65536);
+/** Stop recording trace events. The recorded events are kept until the next #trace_start. */
+T3_WIDGET_API void trace_stop();
+/** Check whether trace events are being recorded. */
+T3_WIDGET_API bool trace_is_enabled();
+
+/** Write the recorded trace events in Chrome trace event format.
+    @return @c true on success, or @c false with @c errno set on failure.
+
+    This may be called while tracing is enabled.
+*/
+T3_WIDGET_API bool trace_write(const char *file_name);
+
+/** Write the recorded trace events when a signal is received.
+    @param signal_number The signal to handle, for example @c SIGUSR1.
+    @param file_name The name of the file to write. Each dump overwrites the previous one.
+    @return @c true on success, or @c false with @c errno set on failure.
+
+    As writing a file is not allowed in a signal handler, the file is written by a background
+    thread.
+*/
+T3_WIDGET_API bool trace_write_on_signal(int signal_number, const char *file_name);
+
+};  // namespace
+#endif
@@ -12,6 +12,7 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "undo.h"
+#include "internal.h"
 #include "textline.h"
 #include <cstdlib>
 #include <cstring>
@@ -98,6 +99,19 @@ void undo_list_t::set_mark() {
 
 bool undo_list_t::is_at_mark() const { return mark_is_valid && mark == current; }
 
+size_t undo_list_t::get_size() const {
+  size_t result = 0;
+  for (const undo_t *undo = head; undo != nullptr; undo = undo->next) result++;
+  return result;
+}
+
+size_t undo_list_t::get_memory_usage() const {
+  size_t result = 0;
+  for (const undo_t *undo = head; undo != nullptr; undo = undo->next)
+    result += undo->get_memory_usage();
+  return result;
+}
+
 #if 0
 #ifdef DEBUG
 #include "log.h"
@@ -179,22 +193,38 @@ std::string *undo_t::get_text() { return nullptr; }
 std::string *undo_t::get_replacement() { return nullptr; }
 text_coordinate_t undo_t::get_end() const { return text_coordinate_t(-1, -1); }
 text_coordinate_t undo_t::get_new_end() const { return text_coordinate_t(-1, -1); }
+size_t undo_t::get_memory_usage() const { return sizeof(undo_t); }
 
 void undo_single_text_t::add_newline() { text.append(1, '\n'); }
 std::string *undo_single_text_t::get_text() { return &text; }
 void undo_single_text_t::minimize() { text.reserve(0); }
+size_t undo_single_text_t::get_memory_usage() const {
+  return sizeof(undo_single_text_t) + string_heap_usage(text);
+}
 
 text_coordinate_t undo_single_text_double_coord_t::get_end() const { return end; }
+size_t undo_single_text_double_coord_t::get_memory_usage() const {
+  return undo_single_text_t::get_memory_usage() + sizeof(undo_single_text_double_coord_t) -
+         sizeof(undo_single_text_t);
+}
 
 std::string *undo_double_text_t::get_replacement() { return &replacement; }
 void undo_double_text_t::minimize() {
   undo_single_text_double_coord_t::minimize();
   replacement.reserve(0);
 }
+size_t undo_double_text_t::get_memory_usage() const {
+  return undo_single_text_double_coord_t::get_memory_usage() + sizeof(undo_double_text_t) -
+         sizeof(undo_single_text_double_coord_t) + string_heap_usage(replacement);
+}
 
 void undo_double_text_triple_coord_t::set_new_end(text_coordinate_t _new_end) {
   new_end = _new_end;
 }
 text_coordinate_t undo_double_text_triple_coord_t::get_new_end() const { return new_end; }
+size_t undo_double_text_triple_coord_t::get_memory_usage() const {
+  return undo_double_text_t::get_memory_usage() + sizeof(undo_double_text_triple_coord_t) -
+         sizeof(undo_double_text_t);
+}
 
 };  // namespace
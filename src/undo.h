@@ -83,6 +83,10 @@ class T3_WIDGET_API undo_list_t {
   undo_t *forward();
   void set_mark();
   bool is_at_mark() const;
+  /** Get the number of undo records in the list. */
+  size_t get_size() const;
+  /** Get the number of bytes of memory used by the undo records in the list. */
+  size_t get_memory_usage() const;
 
 #ifdef DEBUG
   void dump();
@@ -112,6 +116,8 @@ class T3_WIDGET_API undo_t {
   virtual text_coordinate_t get_end() const;
   virtual void minimize() {}
   virtual text_coordinate_t get_new_end() const;
+  /** Get the number of bytes of memory used by this record, including the object itself. */
+  virtual size_t get_memory_usage() const;
 };
 
 class T3_WIDGET_API undo_single_text_t : public undo_t {
@@ -123,6 +129,7 @@ class T3_WIDGET_API undo_single_text_t : public undo_t {
   void add_newline() override;
   std::string *get_text() override;
   void minimize() override;
+  size_t get_memory_usage() const override;
 };
 
 class T3_WIDGET_API undo_single_text_double_coord_t : public undo_single_text_t {
@@ -134,6 +141,7 @@ class T3_WIDGET_API undo_single_text_double_coord_t : public undo_single_text_t
                                   text_coordinate_t _end)
       : undo_single_text_t(_type, _start), end(_end) {}
   text_coordinate_t get_end() const override;
+  size_t get_memory_usage() const override;
 };
 
 class T3_WIDGET_API undo_double_text_t : public undo_single_text_double_coord_t {
@@ -146,6 +154,7 @@ class T3_WIDGET_API undo_double_text_t : public undo_single_text_double_coord_t
 
   std::string *get_replacement() override;
   void minimize() override;
+  size_t get_memory_usage() const override;
 };
 
 class T3_WIDGET_API undo_double_text_triple_coord_t : public undo_double_text_t {
@@ -159,6 +168,7 @@ class T3_WIDGET_API undo_double_text_triple_coord_t : public undo_double_text_t
 
   void set_new_end(text_coordinate_t _new_end);
   text_coordinate_t get_new_end() const override;
+  size_t get_memory_usage() const override;
 };
 
 };  // namespace
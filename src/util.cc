@@ -277,6 +277,13 @@ bool parse_escapes(std::string &str, const char **error_message, bool replacemen
   return true;
 }
 
+size_t string_heap_usage(const std::string &str) {
+  const char *data = str.data();
+  const char *object = reinterpret_cast<const char *>(&str);
+  if (data >= object && data < object + sizeof(str)) return 0;
+  return str.capacity() + 1;
+}
+
 std::string get_working_directory() {
   size_t buffer_max = 511;
   char *buffer = nullptr, *result;
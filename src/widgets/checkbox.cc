@@ -82,6 +82,7 @@ void checkbox_t::set_label(smart_label_t *_label) {
   if (label != nullptr) unregister_mouse_target(label->get_base_window());
   label = _label;
   register_mouse_target(label->get_base_window());
+  invalidate_hotkeys();
 }
 
 bool checkbox_t::is_hotkey(key_t key) { return label == nullptr ? false : label->is_hotkey(key); }
@@ -113,6 +113,10 @@ void edit_window_t::set_text(text_buffer_t *_text, const view_parameters_t *para
   if (text == _text) return;
 
   text = _text;
+  /* Use a new view state, such that the view takes over the cursor position stored in the
+     text_buffer_t, unless another view on the same text is active. */
+  impl->view_state = std::make_shared<text_buffer_t::view_state_t>();
+  activate_view();
   if (params != nullptr) {
     params->apply_parameters(this);
   } else {
@@ -120,8 +124,8 @@ void edit_window_t::set_text(text_buffer_t *_text, const view_parameters_t *para
       impl->wrap_info->set_text_buffer(text);
       impl->wrap_info->set_wrap_width(t3_win_get_width(impl->edit_window) - 1);
     }
-    impl->top_left.line = 0;
-    impl->top_left.pos = 0;
+    impl->view_state->top_left.line = 0;
+    impl->view_state->top_left.pos = 0;
     impl->last_set_pos = 0;
   }
 
@@ -131,8 +135,10 @@ void edit_window_t::set_text(text_buffer_t *_text, const view_parameters_t *para
 }
 
 bool edit_window_t::set_size(optint height, optint width) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   bool result = true;
   // FIXME: these int's are optional!!! Take that into account below!
+  activate_view();
 
   if (width != t3_win_get_width(window) || height > t3_win_get_height(window))
     update_repaint_lines(0, INT_MAX);
@@ -142,10 +148,9 @@ bool edit_window_t::set_size(optint height, optint width) {
   result &= impl->scrollbar->set_size(height - 1, None);
 
   if (impl->wrap_type != wrap_type_t::NONE) {
-    impl->top_left.pos =
-        impl->wrap_info->calculate_line_pos(impl->top_left.line, 0, impl->top_left.pos);
+    top_left.pos = impl->wrap_info->calculate_line_pos(top_left.line, 0, top_left.pos);
     impl->wrap_info->set_wrap_width(width - 1);
-    impl->top_left.pos = impl->wrap_info->find_line(impl->top_left);
+    top_left.pos = impl->wrap_info->find_line(top_left);
     impl->last_set_pos = impl->wrap_info->calculate_screen_pos();
   }
   ensure_cursor_on_screen();
@@ -153,6 +158,7 @@ bool edit_window_t::set_size(optint height, optint width) {
 }
 
 void edit_window_t::ensure_cursor_on_screen() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   int width;
 
   if (text->cursor.pos == text->get_line_max(text->cursor.line))
@@ -163,23 +169,23 @@ void edit_window_t::ensure_cursor_on_screen() {
   if (impl->wrap_type == wrap_type_t::NONE) {
     impl->screen_pos = text->calculate_screen_pos(nullptr, impl->tabsize);
 
-    if (text->cursor.line < impl->top_left.line) {
-      impl->top_left.line = text->cursor.line;
+    if (text->cursor.line < top_left.line) {
+      top_left.line = text->cursor.line;
       update_repaint_lines(0, INT_MAX);
     }
 
-    if (text->cursor.line >= impl->top_left.line + t3_win_get_height(impl->edit_window)) {
-      impl->top_left.line = text->cursor.line - t3_win_get_height(impl->edit_window) + 1;
+    if (text->cursor.line >= top_left.line + t3_win_get_height(impl->edit_window)) {
+      top_left.line = text->cursor.line - t3_win_get_height(impl->edit_window) + 1;
       update_repaint_lines(0, INT_MAX);
     }
 
-    if (impl->screen_pos < impl->top_left.pos) {
-      impl->top_left.pos = impl->screen_pos;
+    if (impl->screen_pos < top_left.pos) {
+      top_left.pos = impl->screen_pos;
       update_repaint_lines(0, INT_MAX);
     }
 
-    if (impl->screen_pos + width > impl->top_left.pos + t3_win_get_width(impl->edit_window)) {
-      impl->top_left.pos = impl->screen_pos + width - t3_win_get_width(impl->edit_window);
+    if (impl->screen_pos + width > top_left.pos + t3_win_get_width(impl->edit_window)) {
+      top_left.pos = impl->screen_pos + width - t3_win_get_width(impl->edit_window);
       update_repaint_lines(0, INT_MAX);
     }
   } else {
@@ -187,17 +193,17 @@ void edit_window_t::ensure_cursor_on_screen() {
     int sub_line = impl->wrap_info->find_line(text->cursor);
     impl->screen_pos = impl->wrap_info->calculate_screen_pos();
 
-    if (text->cursor.line < impl->top_left.line ||
-        (text->cursor.line == impl->top_left.line && sub_line < impl->top_left.pos)) {
-      impl->top_left.line = text->cursor.line;
-      impl->top_left.pos = sub_line;
+    if (text->cursor.line < top_left.line ||
+        (text->cursor.line == top_left.line && sub_line < top_left.pos)) {
+      top_left.line = text->cursor.line;
+      top_left.pos = sub_line;
       update_repaint_lines(0, INT_MAX);
     } else {
-      bottom = impl->top_left;
+      bottom = top_left;
       impl->wrap_info->add_lines(bottom, t3_win_get_height(impl->edit_window) - 1);
 
       while (text->cursor.line > bottom.line) {
-        impl->wrap_info->add_lines(impl->top_left,
+        impl->wrap_info->add_lines(top_left,
                                    impl->wrap_info->get_line_count(bottom.line) - bottom.pos);
         bottom.line++;
         bottom.pos = 0;
@@ -205,14 +211,43 @@ void edit_window_t::ensure_cursor_on_screen() {
       }
 
       if (text->cursor.line == bottom.line && sub_line > bottom.pos) {
-        impl->wrap_info->add_lines(impl->top_left, sub_line - bottom.pos);
+        impl->wrap_info->add_lines(top_left, sub_line - bottom.pos);
         update_repaint_lines(0, INT_MAX);
       }
     }
   }
 }
 
+void edit_window_t::activate_view() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
+
+  text->activate_view(impl->view_state);
+  if (!impl->view_state->changed) return;
+  impl->view_state->changed = false;
+
+  top_left.line = std::min(top_left.line, text->size() - 1);
+  if (impl->wrap_type != wrap_type_t::NONE)
+    top_left.pos = std::min(top_left.pos, impl->wrap_info->get_line_count(top_left.line) - 1);
+  redraw = true;
+  update_repaint_lines(0, INT_MAX);
+}
+
+bool edit_window_t::needs_repaint(int row, int line) {
+  bool in_range = line >= impl->repaint_min && line <= impl->repaint_max;
+  if (text->get_highlighter() == nullptr) return in_range;
+
+  /* An edit may change the highlighting of all lines after it, so lines outside the range are
+     also repainted if the state at their start differs from the last time they were painted. */
+  int state = text->get_highlight_state(line);
+  if (!in_range && state == impl->painted_highlight_states[row]) return false;
+  impl->painted_highlight_states[row] = state;
+  return true;
+}
+
 void edit_window_t::repaint_screen() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
+  scoped_timer_t timer(&impl->last_repaint_time);
+  trace_scope_t trace("edit_window_t::repaint_screen");
   text_coordinate_t current_start, current_end;
   text_line_t::paint_info_t info;
   int i;
@@ -220,6 +255,7 @@ void edit_window_t::repaint_screen() {
   t3_win_set_default_attrs(impl->edit_window, attributes.text);
 
   update_repaint_lines(text->cursor.line, text->cursor.line);
+  impl->painted_highlight_states.resize(t3_win_get_height(impl->edit_window), -1);
 
   current_start = text->get_selection_start();
   current_end = text->get_selection_end();
@@ -236,22 +272,20 @@ void edit_window_t::repaint_screen() {
   info.flags = impl->show_tabs ? text_line_t::SHOW_TABS : 0;
 
   if (impl->wrap_type == wrap_type_t::NONE) {
-    info.leftcol = impl->top_left.pos;
+    info.leftcol = top_left.pos;
     info.start = 0;
     info.max = INT_MAX;
 
     for (i = 0;
-         i < t3_win_get_height(impl->edit_window) && (i + impl->top_left.line) < text->size();
+         i < t3_win_get_height(impl->edit_window) && (i + top_left.line) < text->size();
          i++) {
-      if (impl->top_left.line + i < impl->repaint_min ||
-          impl->top_left.line + i > impl->repaint_max)
-        continue;
+      if (!needs_repaint(i, top_left.line + i)) continue;
 
-      info.selection_start = impl->top_left.line + i == current_start.line ? current_start.pos : -1;
-      if (impl->top_left.line + i >= current_start.line) {
-        if (impl->top_left.line + i < current_end.line)
+      info.selection_start = top_left.line + i == current_start.line ? current_start.pos : -1;
+      if (top_left.line + i >= current_start.line) {
+        if (top_left.line + i < current_end.line)
           info.selection_end = INT_MAX;
-        else if (impl->top_left.line + i == current_end.line)
+        else if (top_left.line + i == current_end.line)
           info.selection_end = current_end.pos;
         else
           info.selection_end = -1;
@@ -260,19 +294,19 @@ void edit_window_t::repaint_screen() {
       }
 
       info.cursor =
-          impl->focus && impl->top_left.line + i == text->cursor.line ? text->cursor.pos : -1;
+          impl->focus && top_left.line + i == text->cursor.line ? text->cursor.pos : -1;
       t3_win_set_paint(impl->edit_window, i, 0);
       t3_win_clrtoeol(impl->edit_window);
-      text->paint_line(impl->edit_window, impl->top_left.line + i, &info);
+      text->paint_line(impl->edit_window, top_left.line + i, &info);
     }
   } else {
     text_coordinate_t end_coord = impl->wrap_info->get_end();
-    text_coordinate_t draw_line = impl->top_left;
+    text_coordinate_t draw_line = top_left;
     info.leftcol = 0;
 
     for (i = 0; i < t3_win_get_height(impl->edit_window);
          i++, impl->wrap_info->add_lines(draw_line, 1)) {
-      if (draw_line.line < impl->repaint_min || draw_line.line > impl->repaint_max) continue;
+      if (!needs_repaint(i, draw_line.line)) continue;
       info.selection_start = draw_line.line == current_start.line ? current_start.pos : -1;
       if (draw_line.line >= current_start.line) {
         if (draw_line.line < current_end.line)
@@ -408,6 +442,7 @@ void edit_window_t::dec_y() {
 }
 
 void edit_window_t::pgdn() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   bool need_adjust = true;
 
   if (impl->wrap_type == wrap_type_t::NONE) {
@@ -420,10 +455,10 @@ void edit_window_t::pgdn() {
     }
 
     /* If the end of the text is already on the screen, don't change the top line. */
-    if (impl->top_left.line + t3_win_get_height(impl->edit_window) < text->size()) {
-      impl->top_left.line += t3_win_get_height(impl->edit_window) - 1;
-      if (impl->top_left.line + t3_win_get_height(impl->edit_window) > text->size())
-        impl->top_left.line = text->size() - t3_win_get_height(impl->edit_window);
+    if (top_left.line + t3_win_get_height(impl->edit_window) < text->size()) {
+      top_left.line += t3_win_get_height(impl->edit_window) - 1;
+      if (top_left.line + t3_win_get_height(impl->edit_window) > text->size())
+        top_left.line = text->size() - t3_win_get_height(impl->edit_window);
       update_repaint_lines(0, INT_MAX);
     }
 
@@ -432,7 +467,7 @@ void edit_window_t::pgdn() {
           text->calculate_line_pos(text->cursor.line, impl->last_set_pos, impl->tabsize);
 
   } else {
-    text_coordinate_t new_top_left = impl->top_left;
+    text_coordinate_t new_top_left = top_left;
     text_coordinate_t new_cursor(text->cursor.line, impl->wrap_info->find_line(text->cursor));
 
     if (impl->wrap_info->add_lines(new_cursor, t3_win_get_height(impl->edit_window) - 1)) {
@@ -445,8 +480,8 @@ void edit_window_t::pgdn() {
 
     /* If the end of the text is already on the screen, don't change the top line. */
     if (!impl->wrap_info->add_lines(new_top_left, t3_win_get_height(impl->edit_window))) {
-      impl->top_left = new_top_left;
-      impl->wrap_info->sub_lines(impl->top_left, 1);
+      top_left = new_top_left;
+      impl->wrap_info->sub_lines(top_left, 1);
       update_repaint_lines(0, INT_MAX);
     }
 
@@ -460,12 +495,13 @@ void edit_window_t::pgdn() {
 }
 
 void edit_window_t::pgup() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   bool need_adjust = true;
 
   if (impl->wrap_type == wrap_type_t::NONE) {
-    if (impl->top_left.line < t3_win_get_height(impl->edit_window) - 1) {
-      if (impl->top_left.line != 0) {
-        impl->top_left.line = 0;
+    if (top_left.line < t3_win_get_height(impl->edit_window) - 1) {
+      if (top_left.line != 0) {
+        top_left.line = 0;
         update_repaint_lines(0, INT_MAX);
       }
 
@@ -478,7 +514,7 @@ void edit_window_t::pgup() {
       }
     } else {
       text->cursor.line -= t3_win_get_height(impl->edit_window) - 1;
-      impl->top_left.line -= t3_win_get_height(impl->edit_window) - 1;
+      top_left.line -= t3_win_get_height(impl->edit_window) - 1;
       update_repaint_lines(0, INT_MAX);
     }
 
@@ -497,7 +533,7 @@ void edit_window_t::pgup() {
       text->cursor.line = new_cursor.line;
     }
 
-    impl->wrap_info->sub_lines(impl->top_left, t3_win_get_height(impl->edit_window) - 1);
+    impl->wrap_info->sub_lines(top_left, t3_win_get_height(impl->edit_window) - 1);
     update_repaint_lines(0, INT_MAX);
 
     if (need_adjust)
@@ -558,6 +594,17 @@ void edit_window_t::end_key() {
   impl->last_set_pos = impl->screen_pos;
 }
 
+void edit_window_t::update_selection_end(bool update_primary) {
+  selection_mode_t selection_mode = text->get_selection_mode();
+  if (selection_mode != selection_mode_t::NONE && selection_mode != selection_mode_t::ALL) {
+    text->set_selection_end(update_primary);
+
+    if (selection_mode == selection_mode_t::SHIFT) {
+      if (text->selection_empty()) reset_selection();
+    }
+  }
+}
+
 void edit_window_t::reset_selection() {
   update_repaint_lines(text->get_selection_start().line, text->get_selection_end().line);
   text->set_selection_mode(selection_mode_t::NONE);
@@ -620,6 +667,7 @@ void edit_window_t::find_activated(find_action_t action, finder_t *_finder) {
   finder_t *local_finder;
   find_result_t result;
 
+  activate_view();
   local_finder = impl->finder == nullptr ? &global_finder : impl->finder;
   if (_finder != nullptr) *local_finder = *_finder;
 
@@ -744,6 +792,18 @@ not_found:
 
 // FIXME: make every action into a separate function for readability
 bool edit_window_t::process_key(key_t key) {
+  bool result;
+
+  activate_view();
+  result = handle_key(key);
+  /* Several keys may be processed before the next call to update_contents, for example when
+     pasting. Keys operating on the selection must see the effect of preceding shift-movement
+     keys, so the end of the selection is updated after every key. */
+  update_selection_end(false);
+  return result;
+}
+
+bool edit_window_t::handle_key(key_t key) {
   if (set_selection_mode(key)) return true;
 
   switch (key) {
@@ -787,8 +847,8 @@ bool edit_window_t::process_key(key_t key) {
     case EKEY_HOME | EKEY_CTRL:
       impl->screen_pos = impl->last_set_pos = text->cursor.pos = 0;
       text->cursor.line = 0;
-      if ((impl->wrap_type == wrap_type_t::NONE && impl->top_left.pos != 0) ||
-          impl->top_left.line != 0)
+      if ((impl->wrap_type == wrap_type_t::NONE && impl->view_state->top_left.pos != 0) ||
+          impl->view_state->top_left.line != 0)
         ensure_cursor_on_screen();
       break;
     case EKEY_END | EKEY_SHIFT:
@@ -884,10 +944,12 @@ bool edit_window_t::process_key(key_t key) {
       } else {
         delete_selection();
       }
-      if (impl->autocomplete_panel->is_shown()) activate_autocomplete(false);
+      if (impl->autocomplete_panel->is_shown() || impl->autocomplete_pending)
+        activate_autocomplete(false);
       break;
 
     case EKEY_ESC:
+      impl->autocomplete_pending = false;
       if (text->get_selection_mode() == selection_mode_t::MARK) reset_selection();
       break;
 
@@ -1008,7 +1070,8 @@ bool edit_window_t::process_key(key_t key) {
       ensure_cursor_on_screen();
       update_repaint_lines(text->cursor.line, text->cursor.line);
       impl->last_set_pos = impl->screen_pos;
-      if (impl->autocomplete_panel->is_shown()) activate_autocomplete(false);
+      if (impl->autocomplete_panel->is_shown() || impl->autocomplete_pending)
+        activate_autocomplete(false);
       break;
     }
   }
@@ -1016,10 +1079,12 @@ bool edit_window_t::process_key(key_t key) {
 }
 
 void edit_window_t::update_contents() {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   text_coordinate_t logical_cursor_pos;
   char info[30];
   int info_width, name_width;
-  selection_mode_t selection_mode;
+
+  activate_view();
 
   /* TODO: see if we can optimize this somewhat by not redrawing the whole thing
      on every key.
@@ -1029,14 +1094,7 @@ void edit_window_t::update_contents() {
   */
   if (!impl->focus && !redraw) return;
 
-  selection_mode = text->get_selection_mode();
-  if (selection_mode != selection_mode_t::NONE && selection_mode != selection_mode_t::ALL) {
-    text->set_selection_end();
-
-    if (selection_mode == selection_mode_t::SHIFT) {
-      if (text->selection_empty()) reset_selection();
-    }
-  }
+  update_selection_end(true);
 
   redraw = false;
   repaint_screen();
@@ -1047,12 +1105,12 @@ void edit_window_t::update_contents() {
 
   if (impl->wrap_type == wrap_type_t::NONE) {
     impl->scrollbar->set_parameters(
-        std::max(text->size(), impl->top_left.line + t3_win_get_height(impl->edit_window)),
-        impl->top_left.line, t3_win_get_height(impl->edit_window));
+        std::max(text->size(), top_left.line + t3_win_get_height(impl->edit_window)),
+        top_left.line, t3_win_get_height(impl->edit_window));
   } else {
     int i, count = 0;
-    for (i = 0; i < impl->top_left.line; i++) count += impl->wrap_info->get_line_count(i);
-    count += impl->top_left.pos;
+    for (i = 0; i < top_left.line; i++) count += impl->wrap_info->get_line_count(i);
+    count += top_left.pos;
 
     impl->scrollbar->set_parameters(
         std::max(impl->wrap_info->get_text_size(), count + t3_win_get_height(impl->edit_window)),
@@ -1080,14 +1138,17 @@ void edit_window_t::update_contents() {
 }
 
 void edit_window_t::set_focus(focus_t _focus) {
+  activate_view();
   if (_focus != impl->focus) {
     impl->focus = _focus;
     impl->autocomplete_panel->hide();
+    impl->autocomplete_pending = false;
     update_repaint_lines(text->cursor.line, text->cursor.line);
   }
 }
 
 void edit_window_t::undo() {
+  activate_view();
   if (text->apply_undo() == 0) {
     update_repaint_lines(0, INT_MAX);
     ensure_cursor_on_screen();
@@ -1096,6 +1157,7 @@ void edit_window_t::undo() {
 }
 
 void edit_window_t::redo() {
+  activate_view();
   if (text->apply_redo() == 0) {
     update_repaint_lines(0, INT_MAX);
     ensure_cursor_on_screen();
@@ -1104,6 +1166,7 @@ void edit_window_t::redo() {
 }
 
 void edit_window_t::cut_copy(bool cut) {
+  activate_view();
   if (text->get_selection_mode() != selection_mode_t::NONE) {
     if (text->selection_empty()) {
       reset_selection();
@@ -1119,9 +1182,15 @@ void edit_window_t::cut_copy(bool cut) {
   }
 }
 
-void edit_window_t::paste() { paste(true); }
+void edit_window_t::paste() {
+  activate_view();
+  paste(true);
+}
 
-void edit_window_t::paste_selection() { paste(false); }
+void edit_window_t::paste_selection() {
+  activate_view();
+  paste(false);
+}
 
 void edit_window_t::paste(bool clipboard) {
   WITH_CLIPBOARD_LOCK(
@@ -1147,6 +1216,7 @@ void edit_window_t::paste(bool clipboard) {
 }
 
 void edit_window_t::select_all() {
+  activate_view();
   text->set_selection_mode(selection_mode_t::ALL);
   update_repaint_lines(0, INT_MAX);
 }
@@ -1158,6 +1228,7 @@ void edit_window_t::insert_special() {
 }
 
 void edit_window_t::indent_selection() {
+  activate_view();
   text->indent_selection(impl->tabsize, impl->tab_spaces);
   ensure_cursor_on_screen();
   impl->last_set_pos = impl->screen_pos;
@@ -1165,6 +1236,7 @@ void edit_window_t::indent_selection() {
 }
 
 void edit_window_t::unindent_selection() {
+  activate_view();
   text->unindent_selection(impl->tabsize);
   ensure_cursor_on_screen();
   impl->last_set_pos = impl->screen_pos;
@@ -1181,6 +1253,7 @@ void edit_window_t::goto_line() {
 }
 
 void edit_window_t::goto_line(int line) {
+  activate_view();
   if (line < 1) return;
 
   reset_selection();
@@ -1192,6 +1265,7 @@ void edit_window_t::goto_line(int line) {
 
 void edit_window_t::find_replace(bool replace) {
   find_dialog_t *dialog;
+  activate_view();
   if (impl->find_dialog == nullptr) {
     global_find_dialog_connection.disconnect();
     global_find_dialog_connection = global_find_dialog->connect_activate(
@@ -1211,6 +1285,7 @@ void edit_window_t::find_replace(bool replace) {
 
 void edit_window_t::find_next(bool backward) {
   find_result_t result;
+  activate_view();
   if (text->get_selection_mode() == selection_mode_t::NONE) {
     result.start = text->cursor;
 
@@ -1241,6 +1316,7 @@ void edit_window_t::set_find_dialog(find_dialog_t *_find_dialog) {
 void edit_window_t::set_finder(finder_t *_finder) { impl->finder = _finder; }
 
 void edit_window_t::force_redraw() {
+  activate_view();
   widget_t::force_redraw();
   update_repaint_lines(0, INT_MAX);
   draw_info_window();
@@ -1264,6 +1340,7 @@ void edit_window_t::set_child_focus(window_component_t *target) {
 bool edit_window_t::is_child(window_component_t *widget) { return widget == impl->scrollbar; }
 
 bool edit_window_t::process_mouse_event(mouse_event_t event) {
+  activate_view();
   if (event.window == impl->edit_window) {
     if (event.button_state & EMOUSE_TRIPLE_CLICKED_LEFT) {
       text->cursor.pos = 0;
@@ -1296,7 +1373,7 @@ bool edit_window_t::process_mouse_event(mouse_event_t event) {
       impl->last_set_pos = impl->screen_pos;
     } else if (event.type == EMOUSE_BUTTON_PRESS &&
                (event.button_state & (EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN))) {
-      scroll(event.button_state & EMOUSE_SCROLL_UP ? -3 : 3);
+      scroll(event.button_state & EMOUSE_SCROLL_UP ? -3 * event.count : 3 * event.count);
     } else if ((event.type == EMOUSE_MOTION && (event.button_state & EMOUSE_BUTTON_LEFT)) ||
                (event.type == EMOUSE_BUTTON_RELEASE &&
                 (event.previous_button_state & EMOUSE_BUTTON_LEFT))) {
@@ -1318,10 +1395,12 @@ bool edit_window_t::process_mouse_event(mouse_event_t event) {
 }
 
 void edit_window_t::set_wrap(wrap_type_t wrap) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   if (wrap == impl->wrap_type) return;
+  activate_view();
 
   if (wrap == wrap_type_t::NONE) {
-    impl->top_left.pos = 0;
+    top_left.pos = 0;
     if (impl->wrap_info != nullptr) {
       delete impl->wrap_info;
       impl->wrap_info = nullptr;
@@ -1332,7 +1411,7 @@ void edit_window_t::set_wrap(wrap_type_t wrap) {
       impl->wrap_info = new wrap_info_t(t3_win_get_width(impl->edit_window) - 1, impl->tabsize);
     impl->wrap_info->set_text_buffer(text);
     impl->wrap_info->set_wrap_width(t3_win_get_width(impl->edit_window) - 1);
-    impl->top_left.pos = impl->wrap_info->find_line(impl->top_left);
+    top_left.pos = impl->wrap_info->find_line(top_left);
   }
   impl->wrap_type = wrap;
   update_repaint_lines(0, INT_MAX);
@@ -1361,6 +1440,21 @@ bool edit_window_t::get_indent_aware_home() { return impl->indent_aware_home; }
 
 bool edit_window_t::get_show_tabs() { return impl->show_tabs; }
 
+edit_window_t::stats_t edit_window_t::get_stats() const {
+  stats_t stats;
+  if (impl->wrap_info != nullptr) {
+    stats.wrap_lines = impl->wrap_info->get_text_size();
+    stats.wrap_bytes = impl->wrap_info->get_memory_usage();
+    stats.last_rewrap_time = impl->wrap_info->get_last_rewrap_time();
+  } else {
+    stats.wrap_lines = 0;
+    stats.wrap_bytes = 0;
+    stats.last_rewrap_time = std::chrono::nanoseconds(0);
+  }
+  stats.last_repaint_time = impl->last_repaint_time;
+  return stats;
+}
+
 edit_window_t::view_parameters_t *edit_window_t::save_view_parameters() {
   return new view_parameters_t(this);
 }
@@ -1373,18 +1467,44 @@ void edit_window_t::draw_info_window() {}
 
 void edit_window_t::set_autocompleter(autocompleter_t *_autocompleter) {
   impl->autocomplete_panel->hide();
+  impl->autocomplete_pending = false;
+  impl->completions_ready_connection.disconnect();
   impl->autocompleter = _autocompleter;
+
+  async_autocompleter_t *async_autocompleter =
+      dynamic_cast<async_autocompleter_t *>(_autocompleter);
+  if (async_autocompleter != nullptr) {
+    impl->completions_ready_connection = async_autocompleter->connect_completions_ready(
+        signals::mem_fun(this, &edit_window_t::autocomplete_ready));
+  }
 }
 
-void edit_window_t::autocomplete() { activate_autocomplete(true); }
+void edit_window_t::autocomplete() {
+  activate_view();
+  activate_autocomplete(true);
+}
 
 void edit_window_t::activate_autocomplete(bool autocomplete_single) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   if (impl->autocompleter == nullptr) return;
 
   text_coordinate_t anchor(text->cursor);
   string_list_base_t *autocomplete_list =
       impl->autocompleter->build_autocomplete_list(text, &anchor.pos);
 
+  impl->autocomplete_pending = false;
+  if (autocomplete_list == nullptr) {
+    async_autocompleter_t *async_autocompleter =
+        dynamic_cast<async_autocompleter_t *>(impl->autocompleter());
+    /* Leave the panel as it is until the results are available, to prevent flickering while
+       typing. */
+    if (async_autocompleter != nullptr && async_autocompleter->is_pending()) {
+      impl->autocomplete_pending = true;
+      impl->autocomplete_pending_single = autocomplete_single;
+      return;
+    }
+  }
+
   if (autocomplete_list != nullptr) {
     if (autocomplete_single && autocomplete_list->size() == 1) {
       impl->autocompleter->autocomplete(text, 0);
@@ -1396,18 +1516,18 @@ void edit_window_t::activate_autocomplete(bool autocomplete_single) {
     impl->autocomplete_panel->set_completions(autocomplete_list);
     if (impl->wrap_type == wrap_type_t::NONE) {
       int position = text->calculate_screen_pos(&anchor, impl->tabsize);
-      impl->autocomplete_panel->set_position(text->cursor.line - impl->top_left.line + 1,
-                                             position - impl->top_left.pos - 1);
+      impl->autocomplete_panel->set_position(text->cursor.line - top_left.line + 1,
+                                             position - top_left.pos - 1);
     } else {
       int sub_line = impl->wrap_info->find_line(text->cursor);
       int position = impl->wrap_info->calculate_screen_pos(&anchor);
       int line;
 
-      if (text->cursor.line == impl->top_left.line) {
-        line = sub_line - impl->top_left.pos;
+      if (text->cursor.line == top_left.line) {
+        line = sub_line - top_left.pos;
       } else {
-        line = impl->wrap_info->get_line_count(impl->top_left.line) - impl->top_left.pos + sub_line;
-        for (int i = impl->top_left.line + 1; i < text->cursor.line; i++)
+        line = impl->wrap_info->get_line_count(top_left.line) - top_left.pos + sub_line;
+        for (int i = top_left.line + 1; i < text->cursor.line; i++)
           line += impl->wrap_info->get_line_count(i);
       }
       impl->autocomplete_panel->set_position(line + 1, position - 1);
@@ -1418,17 +1538,25 @@ void edit_window_t::activate_autocomplete(bool autocomplete_single) {
   }
 }
 
+void edit_window_t::autocomplete_ready() {
+  if (!impl->autocomplete_pending) return;
+  activate_view();
+  activate_autocomplete(impl->autocomplete_pending_single);
+}
+
 void edit_window_t::autocomplete_activated() {
+  activate_view();
   size_t idx = impl->autocomplete_panel->get_selected_idx();
   impl->autocomplete_panel->hide();
   impl->autocompleter->autocomplete(text, idx);
 }
 
 text_coordinate_t edit_window_t::xy_to_text_coordinate(int x, int y) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   text_coordinate_t coord;
   if (impl->wrap_type == wrap_type_t::NONE) {
-    coord.line = y + impl->top_left.line;
-    x += impl->top_left.pos;
+    coord.line = y + top_left.line;
+    x += top_left.pos;
     if (coord.line >= text->size()) {
       coord.line = text->size() - 1;
       x = INT_MAX;
@@ -1440,8 +1568,8 @@ text_coordinate_t edit_window_t::xy_to_text_coordinate(int x, int y) {
       coord.pos = text->calculate_line_pos(coord.line, x, impl->tabsize);
     }
   } else {
-    coord.line = impl->top_left.line;
-    y += impl->top_left.pos;
+    coord.line = top_left.line;
+    y += top_left.pos;
     while (y < 0 && coord.line > 0) {
       coord.line--;
       y += impl->wrap_info->get_line_count(coord.line);
@@ -1465,29 +1593,31 @@ text_coordinate_t edit_window_t::xy_to_text_coordinate(int x, int y) {
 }
 
 void edit_window_t::scroll(int lines) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
   // FIXME: maybe we should use this for pgup/pgdn and up/down as well?
   if (impl->wrap_type == wrap_type_t::NONE) {
     if (lines < 0) {
-      if (impl->top_left.line > -lines)
-        impl->top_left.line += lines;
+      if (top_left.line > -lines)
+        top_left.line += lines;
       else
-        impl->top_left.line = 0;
+        top_left.line = 0;
     } else {
-      if (impl->top_left.line + t3_win_get_height(impl->edit_window) <= text->size() - lines)
-        impl->top_left.line += lines;
-      else if (impl->top_left.line + t3_win_get_height(impl->edit_window) - 1 < text->size())
-        impl->top_left.line = text->size() - t3_win_get_height(impl->edit_window);
+      if (top_left.line + t3_win_get_height(impl->edit_window) <= text->size() - lines)
+        top_left.line += lines;
+      else if (top_left.line + t3_win_get_height(impl->edit_window) - 1 < text->size())
+        top_left.line = text->size() - t3_win_get_height(impl->edit_window);
     }
   } else {
     if (lines < 0)
-      impl->wrap_info->sub_lines(impl->top_left, -lines);
+      impl->wrap_info->sub_lines(top_left, -lines);
     else
-      impl->wrap_info->add_lines(impl->top_left, lines);
+      impl->wrap_info->add_lines(top_left, lines);
   }
   update_repaint_lines(0, INT_MAX);
 }
 
 void edit_window_t::scrollbar_clicked(scrollbar_t::step_t step) {
+  activate_view();
   scroll(step == scrollbar_t::BACK_SMALL
              ? -3
              : step == scrollbar_t::FWD_SMALL
@@ -1504,10 +1634,12 @@ void edit_window_t::scrollbar_clicked(scrollbar_t::step_t step) {
 }
 
 void edit_window_t::scrollbar_dragged(int start) {
+  text_coordinate_t &top_left = impl->view_state->top_left;
+  activate_view();
   if (impl->wrap_type == wrap_type_t::NONE) {
     if (start >= 0 && start + t3_win_get_height(impl->edit_window) <= text->size() &&
-        start != impl->top_left.line) {
-      impl->top_left.line = start;
+        start != top_left.line) {
+      top_left.line = start;
       update_repaint_lines(0, INT_MAX);
     }
   } else {
@@ -1528,8 +1660,8 @@ void edit_window_t::scrollbar_dragged(int start) {
       new_top_left.pos = start - count;
     }
 
-    if (new_top_left == impl->top_left || new_top_left.line < 0) return;
-    impl->top_left = new_top_left;
+    if (new_top_left == top_left || new_top_left.line < 0) return;
+    top_left = new_top_left;
     update_repaint_lines(0, INT_MAX);
   }
 }
@@ -1549,6 +1681,7 @@ void edit_window_t::update_repaint_lines(int start, int end) {
 void edit_window_t::delete_line() {
   text_coordinate_t start;
   text_coordinate_t end;
+  activate_view();
   if (text->selection_empty()) {
     start = text->cursor;
     end = text->cursor;
@@ -1595,7 +1728,7 @@ void edit_window_t::mark_selection() {
 //====================== view_parameters_t ========================
 
 edit_window_t::view_parameters_t::view_parameters_t(edit_window_t *view) {
-  top_left = view->impl->top_left;
+  top_left = view->impl->view_state->top_left;
   wrap_type = view->impl->wrap_type;
   if (wrap_type != wrap_type_t::NONE)
     top_left.pos = view->impl->wrap_info->calculate_line_pos(top_left.line, 0, top_left.pos);
@@ -1620,14 +1753,14 @@ edit_window_t::view_parameters_t::view_parameters_t()
       show_tabs(false) {}
 
 void edit_window_t::view_parameters_t::apply_parameters(edit_window_t *view) const {
-  view->impl->top_left = top_left;
+  view->impl->view_state->top_left = top_left;
   view->impl->tabsize = tabsize;
   view->set_wrap(wrap_type);
   /* view->set_wrap will make sure that view->wrap_info is nullptr if
      wrap_type != NONE. */
   if (view->impl->wrap_info != nullptr) {
     view->impl->wrap_info->set_text_buffer(view->text);
-    view->impl->top_left.pos = view->impl->wrap_info->find_line(top_left);
+    view->impl->view_state->top_left.pos = view->impl->wrap_info->find_line(top_left);
   }
   // the calling function will call ensure_cursor_on_screen
   view->impl->tab_spaces = tab_spaces;
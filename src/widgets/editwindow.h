@@ -18,7 +18,9 @@ namespace t3_widget {
 class edit_window_t;
 };  // namespace
 
+#include <chrono>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -74,11 +76,6 @@ class T3_WIDGET_API edit_window_t : public widget_t,
     wrap_type_t wrap_type; /**< The wrap_type_t used for display. */
     wrap_info_t
         *wrap_info; /**< Required information for wrapped display, or @c NULL if not in use. */
-    /** The top-left coordinate in the text.
-            This is either a proper text_coordinate_t when wrapping is disabled, or
-            a line and sub-line (pos @c member) coordinate when wrapping is enabled.
-    */
-    text_coordinate_t top_left;
     int ins_mode,     /**< Current insert/overwrite mode. */
         last_set_pos; /**< Last horiziontal position set by user action. */
     bool auto_indent; /**< Boolean indicating whether automatic indentation should be enabled. */
@@ -92,9 +89,25 @@ class T3_WIDGET_API edit_window_t : public widget_t,
     cleanup_ptr<autocompleter_t>::t autocompleter; /**< Object used for autocompletion. */
     cleanup_ptr<autocomplete_panel_t>::t
         autocomplete_panel; /**< Panel for showing autocomplete options. */
+    /** Connection to the completions_ready signal of an async_autocompleter_t. */
+    signals::connection completions_ready_connection;
+    /** Boolean indicating whether the autocomplete panel should be activated when the results
+        of an async_autocompleter_t become available. */
+    bool autocomplete_pending;
+    /** Value of autocomplete_single for the pending autocomplete panel activation. */
+    bool autocomplete_pending_single;
 
     int repaint_min, /**< First line to repaint. */
         repaint_max; /**< Last line to repaint. */
+    /** Cursor, selection and top-left coordinate of this view on the text_buffer_t.
+            The top-left coordinate is either a proper text_coordinate_t when wrapping is
+            disabled, or a line and sub-line (pos @c member) coordinate when wrapping is enabled.
+    */
+    std::shared_ptr<text_buffer_t::view_state_t> view_state;
+    /** Highlighter state at the start of the line painted in each row of the window.
+        Used to repaint lines outside the repaint range for which the highlighting changed. */
+    std::vector<int> painted_highlight_states;
+    std::chrono::nanoseconds last_repaint_time; /**< Duration of the last #repaint_screen. */
 
     implementation_t()
         : screen_pos(0),
@@ -113,8 +126,11 @@ class T3_WIDGET_API edit_window_t : public widget_t,
           show_tabs(false),
           autocompleter(NULL),
           autocomplete_panel(NULL),
+          autocomplete_pending(false),
+          autocomplete_pending_single(false),
           repaint_min(0),
-          repaint_max(INT_MAX) {}
+          repaint_max(INT_MAX),
+          last_repaint_time(0) {}
   };
   pimpl_ptr<implementation_t>::t impl;
 
@@ -125,8 +141,18 @@ class T3_WIDGET_API edit_window_t : public widget_t,
   /** Function pointer for calling insert/replace depending on insert/overwrite status. */
   static bool (text_buffer_t::*proces_char[])(key_t);
 
+  /** Make this the active view on #text.
+
+      This is done on entry: in the widget_t and public member functions, and in the callbacks
+      connected to signals. Other member functions assume the view is already active. If the
+      text was edited through another view in the meantime, the top-left coordinate is limited
+      to the current contents and the whole view is redrawn.
+  */
+  void activate_view();
   /** Redraw the contents of the edit_window_t. */
   void repaint_screen();
+  /** Determine whether @p line, painted in @p row of the window, must be repainted. */
+  bool needs_repaint(int row, int line);
   /** Handle cursor right key. */
   void inc_x();
   /** Handle control-cursor right key. */
@@ -147,6 +173,10 @@ class T3_WIDGET_API edit_window_t : public widget_t,
   void home_key();
   /** Handle end key. */
   void end_key();
+  /** Handle a key, without updating the end of the selection afterwards. */
+  bool handle_key(key_t key);
+  /** Move the end of the selection to the cursor, or reset an empty shift-selection. */
+  void update_selection_end(bool update_primary);
   /** Reset the selection. */
   void reset_selection();
   /** Set the selection mode based on the current key pressed by the user. */
@@ -163,6 +193,8 @@ class T3_WIDGET_API edit_window_t : public widget_t,
   void scrollbar_clicked(scrollbar_t::step_t step);
   void scrollbar_dragged(int start);
   void autocomplete_activated();
+  /** Handle the availability of the results of an async_autocompleter_t. */
+  void autocomplete_ready();
   void mark_selection();
   /** Pastes either the selection, or the clipboard. */
   void paste(bool clipboard);
@@ -199,6 +231,15 @@ class T3_WIDGET_API edit_window_t : public widget_t,
  public:
   class T3_WIDGET_API view_parameters_t;
 
+  /** Statistics about the display of the text, as returned by #get_stats. Use
+      text_buffer_t::get_stats for statistics about the text itself. */
+  struct T3_WIDGET_API stats_t {
+    size_t wrap_lines; /**< Number of screen lines of the wrapped text, or 0 without wrapping. */
+    size_t wrap_bytes; /**< Memory used for the wrap points, in bytes. */
+    std::chrono::nanoseconds last_rewrap_time;  /**< Duration of the last rewrap. */
+    std::chrono::nanoseconds last_repaint_time; /**< Duration of the last repaint of the text. */
+  };
+
   /** Create a new edit_window_t.
       @param _text The text to display in the edit_window_t.
       @param params The view parameters to set.
@@ -300,6 +341,8 @@ class T3_WIDGET_API edit_window_t : public widget_t,
   bool get_indent_aware_home();
   /** Get show tabs. */
   bool get_show_tabs();
+  /** Get statistics about the display of the text. */
+  stats_t get_stats() const;
 
   /** Save the current view parameters, to allow them to be restored later. */
   view_parameters_t *save_view_parameters();
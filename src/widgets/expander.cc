@@ -92,7 +92,7 @@ void expander_t::set_expanded(bool expand) {
 }
 
 bool expander_t::process_key(key_t key) {
-  lprintf("Handling key %08x impl->focus: %d\n", key, impl->focus);
+  lcprintf(LOG_WIDGETS, LOG_DEBUG, "Handling key %08x impl->focus: %d\n", key, impl->focus);
   if (impl->focus == FOCUS_SELF) {
     if (impl->is_expanded && impl->child != nullptr && (key == '\t' || key == EKEY_DOWN)) {
       if (impl->child->accepts_focus()) {
@@ -11,6 +11,9 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+#include <unicase.h>
+
 #include "widgets/filepane.h"
 #include "colorscheme.h"
 #include "main.h"
@@ -156,7 +159,7 @@ void file_pane_t::draw_line(int idx, bool selected) {
 
   int column;
   int height = t3_win_get_height(window) - 1;
-  text_line_t line((*impl->file_list)[idx]);
+  text_line_t *line = get_name_line(idx);
   bool is_dir = impl->file_list->is_dir(idx);
   text_line_t::paint_info_t info;
 
@@ -180,7 +183,29 @@ void file_pane_t::draw_line(int idx, bool selected) {
   info.normal_attr = attributes.dialog;
   info.selected_attr = attributes.dialog_selected;
 
-  line.paint_line(window, &info);
+  line->paint_line(window, &info);
+}
+
+int file_pane_t::get_name_width(size_t idx) {
+  /* Lists which change without emitting content_changed would otherwise index out of range. */
+  if (impl->name_widths.size() != impl->file_list->size()) reset_name_cache();
+  int &width = impl->name_widths[idx];
+  if (width < 0) width = t3_term_strwidth((*impl->file_list)[idx]->c_str());
+  return width;
+}
+
+text_line_t *file_pane_t::get_name_line(size_t idx) {
+  if (impl->name_lines.size() != impl->file_list->size()) reset_name_cache();
+  std::unique_ptr<text_line_t> &line = impl->name_lines[idx];
+  if (line == nullptr) line.reset(new text_line_t((*impl->file_list)[idx]));
+  return line.get();
+}
+
+void file_pane_t::reset_name_cache() {
+  size_t size = impl->file_list == nullptr ? 0 : impl->file_list->size();
+  impl->name_widths.assign(size, -1);
+  impl->name_lines.clear();
+  impl->name_lines.resize(size);
 }
 
 void file_pane_t::update_contents() {
@@ -276,12 +301,13 @@ void file_pane_t::set_file(const std::string *name) {
   ensure_cursor_on_screen();
 }
 
+void file_pane_t::set_search_mode(search_mode_t mode) { impl->search_mode = mode; }
+
 void file_pane_t::update_column_width(int column, int start) {
   int height = t3_win_get_height(window) - 1;
   impl->column_widths[column] = 0;
   for (int i = 0; i < height && start + i < (int)impl->file_list->size(); i++)
-    impl->column_widths[column] = std::max(
-        impl->column_widths[column], t3_term_strwidth((*impl->file_list)[i + start]->c_str()));
+    impl->column_widths[column] = std::max(impl->column_widths[column], get_name_width(i + start));
 }
 
 void file_pane_t::update_column_widths() {
@@ -323,6 +349,10 @@ void file_pane_t::content_changed() {
   int height = t3_win_get_height(window) - 1;
 
   impl->top_idx = 0;
+  impl->search_index_valid = false;
+  impl->search_index.clear();
+  impl->folded_names.clear();
+  reset_name_cache();
   update_column_widths();
   impl->scrollbar_range = ((impl->file_list->size() + height - 1) / height) * height;
   redraw = true;
@@ -386,24 +416,149 @@ void file_pane_t::scrollbar_dragged(int start) {
   }
 }
 
+/* Return the case-folded version of @p name. */
+static std::string fold_name(const std::string &name) {
+  size_t folded_size;
+  cleanup_free_ptr<char>::t folded((char *)u8_casefold(
+      (const uint8_t *)name.data(), name.size(), nullptr, nullptr, nullptr, &folded_size));
+  if (folded == nullptr) return name;
+  return std::string(folded(), folded_size);
+}
+
+/* Return the length of the common prefix of @p a and @p b, in bytes. */
+static size_t common_prefix_length(const std::string &a, const std::string &b) {
+  size_t i;
+  for (i = 0; i < a.size() && i < b.size() && a[i] == b[i]; i++) {
+  }
+  return i;
+}
+
+/* Score the match of the characters of @p needle as a subsequence of @p name, or return -1 if
+   they do not all occur in order. Both must be case-folded. Each matched character scores one
+   point, with a bonus for matches at the start of the name or of a word, and for consecutive
+   matches. Characters are matched leftmost-first, which is not guaranteed to find the best
+   scoring match, but is good enough for ranking. */
+static int fuzzy_score(const std::string &name, const std::string &needle) {
+  int score = 0;
+  size_t pos = 0;
+
+  for (size_t i = 0; i < needle.size();) {
+    size_t char_end = i + 1;
+    while (char_end < needle.size() && (needle[char_end] & 0xC0) == 0x80) char_end++;
+
+    size_t found = name.find(needle.data() + i, pos, char_end - i);
+    if (found == std::string::npos) return -1;
+
+    score++;
+    if (found == 0) {
+      score += 8;
+    } else if (found == pos && i > 0) {
+      score += 4;
+    } else {
+      char c = name[found - 1];
+      if (c == '.' || c == '_' || c == '-' || c == ' ') score += 3;
+    }
+    pos = found + char_end - i;
+    i = char_end;
+  }
+  return score;
+}
+
+void file_pane_t::update_search_index() {
+  if (impl->search_mode == SEARCH_FUZZY) {
+    if (impl->folded_names.size() == impl->file_list->size()) return;
+    impl->folded_names.clear();
+    impl->folded_names.reserve(impl->file_list->size());
+    for (size_t i = 0; i < impl->file_list->size(); i++)
+      impl->folded_names.push_back(fold_name(*(*impl->file_list)[i]));
+    return;
+  }
+
+  if (impl->search_index_valid) return;
+  /* The file list is sorted by type and then using strcoll, which does not correspond to the byte
+     order used for matching the typed text. Hence a separate index is required. */
+  impl->search_index.resize(impl->file_list->size());
+  for (size_t i = 0; i < impl->search_index.size(); i++) impl->search_index[i] = i;
+  const file_list_t *file_list = impl->file_list;
+  std::sort(impl->search_index.begin(), impl->search_index.end(),
+            [file_list](size_t a, size_t b) {
+              int result = (*file_list)[a]->compare(*(*file_list)[b]);
+              return result < 0 || (result == 0 && a < b);
+            });
+  impl->search_index_valid = true;
+}
+
 void file_pane_t::search(const std::string *text) {
-  size_t i, j;
+  if (impl->file_list == nullptr || impl->file_list->size() == 0) return;
+
+  update_search_index();
+  if (impl->search_mode == SEARCH_FUZZY)
+    search_fuzzy(text);
+  else
+    search_prefix(text);
+}
+
+void file_pane_t::search_prefix(const std::string *text) {
+  const file_list_t *file_list = impl->file_list;
+  const std::vector<size_t> &index = impl->search_index;
+
+  /* The entries with the longest common prefix with text are adjacent to the position where
+     text would be inserted in the index. */
+  std::vector<size_t>::const_iterator insert_pos = std::lower_bound(
+      index.begin(), index.end(), *text,
+      [file_list](size_t idx, const std::string &str) { return *(*file_list)[idx] < str; });
+
   size_t longest_match = 0;
-  size_t longest_match_idx = 0;
+  if (insert_pos != index.end())
+    longest_match = common_prefix_length(*(*file_list)[*insert_pos], *text);
+  if (insert_pos != index.begin())
+    longest_match =
+        std::max(longest_match, common_prefix_length(*(*file_list)[*(insert_pos - 1)], *text));
+
+  // Adjust match length to start of UTF-8 character.
+  while (longest_match > 0 && longest_match < text->size() &&
+         ((*text)[longest_match] & 0xC0) == 0x80)
+    longest_match--;
+  if (longest_match == 0) return;
+
+  /* Find the range of entries starting with the matched prefix. */
+  std::string prefix = text->substr(0, longest_match);
+  std::vector<size_t>::const_iterator first = std::lower_bound(
+      index.begin(), insert_pos, prefix,
+      [file_list](size_t idx, const std::string &str) { return *(*file_list)[idx] < str; });
+  std::vector<size_t>::const_iterator last =
+      std::upper_bound(insert_pos, index.end(), prefix,
+                       [file_list, longest_match](const std::string &str, size_t idx) {
+                         return (*file_list)[idx]->compare(0, longest_match, str) > 0;
+                       });
+
+  /* Select the entry listed first, as it is the one closest to the start of the list. In the
+     common case where more text is typed, the range quickly becomes small. */
+  size_t match_idx = *std::min_element(first, last);
+  if (impl->current != match_idx) {
+    impl->current = match_idx;
+    redraw = true;
+    ensure_cursor_on_screen();
+  }
+}
 
-  for (i = 0; i < impl->file_list->size(); i++) {
-    for (j = 0; j < (*impl->file_list)[i]->size() && j < text->size(); j++) {
-      if ((*(*impl->file_list)[i])[j] != (*text)[j]) break;
-    }
-    // Adjust match length to start of UTF-8 character.
-    while (j > 0 && ((*text)[j] & 0xC0) == 0x80) j--;
-    if (j > longest_match) {
-      longest_match = j;
-      longest_match_idx = i;
+void file_pane_t::search_fuzzy(const std::string *text) {
+  std::string needle = fold_name(*text);
+  size_t best_idx = 0;
+  int best_score = -1;
+
+  for (size_t i = 0; i < impl->folded_names.size(); i++) {
+    int score = fuzzy_score(impl->folded_names[i], needle);
+    if (score > best_score ||
+        (score == best_score && score >= 0 &&
+         impl->folded_names[i].size() < impl->folded_names[best_idx].size())) {
+      best_score = score;
+      best_idx = i;
     }
   }
-  if (longest_match > 0 && impl->current != longest_match_idx) {
-    impl->current = longest_match_idx;
+
+  if (best_score >= 0 && impl->current != best_idx) {
+    impl->current = best_idx;
     redraw = true;
     ensure_cursor_on_screen();
   }
@@ -14,7 +14,9 @@
 #ifndef T3_WIDGET_FILEPANE_H
 #define T3_WIDGET_FILEPANE_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <t3widget/contentlist.h>
 #include <t3widget/dialogs/popup.h>
@@ -28,6 +30,17 @@ namespace t3_widget {
 
 /** A widget displaying the contents of a directory. */
 class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
+ public:
+  /** Constants defining how typed text selects an entry. */
+  enum search_mode_t {
+    /** Select the first entry with the longest common prefix with the typed text. */
+    SEARCH_PREFIX,
+    /** Select the best matching entry which contains the typed characters in order, ignoring
+        case. Matches at the start of the name or of a word, and consecutive matches rank
+        higher. */
+    SEARCH_FUZZY
+  };
+
  private:
   class search_panel_t;
 
@@ -47,6 +60,18 @@ class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
     signals::connection
         content_changed_connection; /**< Connection to #file_list's content_changed signal. */
     cleanup_ptr<search_panel_t>::t search_panel;
+    search_mode_t search_mode; /**< How typed text selects an entry. */
+    /** Indices into #file_list, sorted by name. Built on the first search after a change of
+        the contents of #file_list. */
+    std::vector<size_t> search_index;
+    /** Case-folded names of the entries of #file_list, for #SEARCH_FUZZY. Built together with
+        #search_index. */
+    std::vector<std::string> folded_names;
+    bool search_index_valid; /**< Boolean indicating whether #search_index is up to date. */
+    /** Width in cells of the names of the entries of #file_list, or -1 if not yet computed. */
+    std::vector<int> name_widths;
+    /** Lines used to paint the names of the entries of #file_list, created on first use. */
+    std::vector<std::unique_ptr<text_line_t>> name_lines;
 
     implementation_t()
         : scrollbar(false),
@@ -56,7 +81,9 @@ class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
           focus(false),
           field(NULL),
           columns_visible(0),
-          scrollbar_range(1) {}
+          scrollbar_range(1),
+          search_mode(SEARCH_PREFIX),
+          search_index_valid(false) {}
   };
   pimpl_ptr<implementation_t>::t impl;
 
@@ -65,6 +92,12 @@ class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
   void ensure_cursor_on_screen();
   /** Draw a single item. */
   void draw_line(int idx, bool selected);
+  /** Get the width in cells of the name of item @p idx, using the cached value if available. */
+  int get_name_width(size_t idx);
+  /** Get the line used to paint the name of item @p idx, creating it if necessary. */
+  text_line_t *get_name_line(size_t idx);
+  /** Discard the cached widths and lines of the items. */
+  void reset_name_cache();
   /** Update the width of a single column, based on the items to draw in it. */
   void update_column_width(int column, int start);
   /** Update the widths of all columns. */
@@ -75,7 +108,12 @@ class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
   void scrollbar_clicked(scrollbar_t::step_t step);
   void scrollbar_dragged(int start);
 
+  /** Build #search_index, and #folded_names if required, if they are not up to date. */
+  void update_search_index();
+  /** Select the entry matching @p text, according to the search mode. */
   void search(const std::string *text);
+  void search_prefix(const std::string *text);
+  void search_fuzzy(const std::string *text);
 
  public:
   file_pane_t();
@@ -101,6 +139,8 @@ class T3_WIDGET_API file_pane_t : public widget_t, public container_t {
   void set_file_list(file_list_t *_file_list);
   /** Set the current selected item to the named item. */
   void set_file(const std::string *name);
+  /** Set how typed text selects an entry. Default is #SEARCH_PREFIX. */
+  void set_search_mode(search_mode_t mode);
 
   T3_WIDGET_SIGNAL(activate, void, const std::string *);
 };
@@ -23,6 +23,7 @@ list_pane_t::list_pane_t(bool _indicator) : impl(new implementation_t(_indicator
 
   init_unbacked_window(1, 4);
   t3_win_set_parent(impl->widgets_window, window);
+  invalidate_target_cache();
   t3_win_set_anchor(impl->widgets_window, window,
                     T3_PARENT(T3_ANCHOR_TOPLEFT) | T3_CHILD(T3_ANCHOR_TOPLEFT));
 
@@ -43,6 +44,7 @@ list_pane_t::~list_pane_t() {
 }
 
 bool list_pane_t::set_widget_parent(window_component_t *widget) {
+  invalidate_target_cache();
   return t3_win_set_parent(widget->get_base_window(), impl->widgets_window);
 }
 
@@ -176,7 +178,7 @@ bool list_pane_t::process_mouse_event(mouse_event_t event) {
     if (impl->single_click_activate) activate();
   } else if (event.type == EMOUSE_BUTTON_PRESS &&
              (event.button_state & (EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN))) {
-    scroll((event.button_state & EMOUSE_SCROLL_UP) ? -3 : 3);
+    scroll((event.button_state & EMOUSE_SCROLL_UP) ? -3 * event.count : 3 * event.count);
   }
   return true;
 }
@@ -47,6 +47,7 @@ void menu_bar_t::add_menu(menu_panel_t *menu) {
   menu->set_position(None, impl->start_col);
   impl->start_col += menu->get_label_width() + 2;
   redraw = true;
+  invalidate_hotkeys();
 }
 
 void menu_bar_t::remove_menu(menu_panel_t *menu) {
@@ -75,6 +76,7 @@ void menu_bar_t::remove_menu(menu_panel_t *menu) {
         impl->start_col += (*iter)->get_label_width() + 2;
       }
       redraw = true;
+      invalidate_hotkeys();
       return;
     }
   }
@@ -151,7 +151,8 @@ bool scrollbar_t::process_mouse_event(mouse_event_t event) {
     impl->dragging = false;
   } else if (event.type == EMOUSE_BUTTON_PRESS &&
              (event.button_state & (EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN))) {
-    clicked((event.button_state & EMOUSE_SCROLL_UP) ? BACK_MEDIUM : FWD_MEDIUM);
+    for (int i = 0; i < event.count; ++i)
+      clicked((event.button_state & EMOUSE_SCROLL_UP) ? BACK_MEDIUM : FWD_MEDIUM);
   }
   /* We don't take focus, so return false. */
   return false;
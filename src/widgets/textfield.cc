@@ -393,7 +393,7 @@ void text_field_t::update_contents() {
 }
 
 void text_field_t::set_focus(focus_t _focus) {
-  lprintf("set focus %d\n", _focus);
+  lcprintf(LOG_WIDGETS, LOG_DEBUG, "set focus %d\n", _focus);
   impl->focus = _focus;
   redraw = true;
   if (impl->focus) {
@@ -471,7 +471,10 @@ void text_field_t::set_autocomplete(string_list_base_t *completions) {
   impl->drop_down_list->set_autocomplete(completions);
 }
 
-void text_field_t::set_label(smart_label_t *_label) { impl->label = _label; }
+void text_field_t::set_label(smart_label_t *_label) {
+  impl->label = _label;
+  invalidate_hotkeys();
+}
 
 bool text_field_t::is_hotkey(key_t key) {
   return impl->label == nullptr ? false : impl->label->is_hotkey(key);
@@ -221,9 +221,9 @@ int text_window_t::get_text_height() { return impl->wrap_info->get_text_size();
 bool text_window_t::process_mouse_event(mouse_event_t event) {
   if (event.window != window || event.type != EMOUSE_BUTTON_PRESS) return true;
   if (event.button_state & EMOUSE_SCROLL_UP)
-    scroll_up(3);
+    scroll_up(3 * event.count);
   else if (event.button_state & EMOUSE_SCROLL_DOWN)
-    scroll_down(3);
+    scroll_down(3 * event.count);
   return true;
 }
 
@@ -23,11 +23,17 @@ namespace t3_widget {
 */
 cleanup_t3_window_ptr widget_t::default_parent(t3_win_new_unbacked(nullptr, 1, 1, 0, 0, 0));
 
+unsigned widget_t::hotkey_generation;
+
 bool widget_t::is_hotkey(key_t key) {
   (void)key;
   return false;
 }
 
+void widget_t::invalidate_hotkeys() { hotkey_generation++; }
+
+unsigned widget_t::get_hotkey_generation() { return hotkey_generation; }
+
 bool widget_t::accepts_focus() { return enabled && shown; }
 
 widget_t::widget_t(int height, int width, bool register_as_mouse_target)
@@ -86,7 +92,8 @@ void widget_t::set_focus(focus_t focus) {
 }
 
 bool widget_t::process_mouse_event(mouse_event_t event) {
-  lprintf("Default mouse handling for %s (%d)\n", typeid(*this).name(), accepts_focus());
+  lcprintf(LOG_WIDGETS, LOG_DEBUG, "Default mouse handling for %s (%d)\n", typeid(*this).name(),
+           accepts_focus());
   return accepts_focus() && (event.button_state & EMOUSE_CLICK_BUTTONS);
 }
 
@@ -27,6 +27,8 @@ class T3_WIDGET_API widget_t : public virtual window_component_t, public mouse_t
 
   /** Default parent for widgets, making them invisible. */
   static cleanup_t3_window_ptr default_parent;
+  /** Counter incremented by #invalidate_hotkeys. */
+  static unsigned hotkey_generation;
 
  protected:
   bool redraw, /**< Widget requires redrawing on next #update_contents call. */
@@ -47,8 +49,20 @@ class T3_WIDGET_API widget_t : public virtual window_component_t, public mouse_t
   void init_unbacked_window(int height, int width, bool register_as_mouse_target = false);
 
  public:
-  /** Query whether key is a hotkey for this widget. */
+  /** Query whether key is a hotkey for this widget.
+
+      Dialogs cache the result for all widgets which are not a container_t, and only call this
+      function again after #invalidate_hotkeys has been called. Widgets for which the result can
+      change other than through being enabled, disabled, shown or hidden, for example because
+      their label can be changed, must call #invalidate_hotkeys when it does. This also applies
+      to widgets implemented outside the library: older versions called this function for each
+      key, so such widgets did not need to signal changes.
+  */
   virtual bool is_hotkey(key_t key);
+  /** Invalidate the cached hotkey information of all dialogs. */
+  static void invalidate_hotkeys();
+  /** Get a counter which changes whenever #invalidate_hotkeys is called. */
+  static unsigned get_hotkey_generation();
   /** Query whether this widget accepts focus. */
   virtual bool accepts_focus();
   void set_position(optint top, optint left) override;
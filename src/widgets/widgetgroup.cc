@@ -83,7 +83,9 @@ bool widget_group_t::process_key(key_t key) {
 }
 
 void widget_group_t::update_contents() {
-  for (widget_t *iter : impl->children) iter->update_contents();
+  for (widget_t *iter : impl->children) {
+    if (iter->is_shown()) iter->update_contents();
+  }
 }
 
 void widget_group_t::set_focus(focus_t focus) {
@@ -18,18 +18,39 @@
 
 namespace t3_widget {
 
-wrap_info_t::wrap_info_t(int width, int _tabsize)
-    : text(nullptr), size(0), tabsize(_tabsize), wrap_width(width) {}
+class wrap_info_t::wrap_cache_t {
+ public:
+  wrap_data_t wrap_data;
+  text_buffer_t *text;
+  int size, tabsize, wrap_width;
+  signals::connection rewrap_connection;
+  std::chrono::nanoseconds last_rewrap_time;
+
+  wrap_cache_t(text_buffer_t *_text, int width, int _tabsize);
+  ~wrap_cache_t();
+
+  void delete_lines(int first, int last);
+  void insert_lines(int first, int last);
+  void rewrap_line(int line, int pos, bool local);
+  void rewrap(rewrap_type_t type, int a, int b);
+};
+
+std::vector<std::weak_ptr<wrap_info_t::wrap_cache_t>> wrap_info_t::wrap_caches;
+
+wrap_info_t::wrap_cache_t::wrap_cache_t(text_buffer_t *_text, int width, int _tabsize)
+    : text(_text), size(0), tabsize(_tabsize), wrap_width(width), last_rewrap_time(0) {
+  scoped_timer_t timer(&last_rewrap_time);
+  trace_scope_t trace("wrap_info_t::wrap_all");
+  rewrap_connection = text->connect_rewrap_required(signals::mem_fun(this, &wrap_cache_t::rewrap));
+  insert_lines(0, text->impl->lines.size());
+}
 
-wrap_info_t::~wrap_info_t() {
+wrap_info_t::wrap_cache_t::~wrap_cache_t() {
   rewrap_connection.disconnect();
   for (wrap_points_t *iter : wrap_data) delete iter;
 }
 
-int wrap_info_t::get_size() const { return wrap_data.size(); }
-int wrap_info_t::get_text_size() const { return size; }
-
-void wrap_info_t::delete_lines(int first, int last) {
+void wrap_info_t::wrap_cache_t::delete_lines(int first, int last) {
   for (wrap_data_t::iterator iter = wrap_data.begin() + first; iter != wrap_data.begin() + last;
        iter++) {
     size -= (*iter)->size();
@@ -38,7 +59,7 @@ void wrap_info_t::delete_lines(int first, int last) {
   wrap_data.erase(wrap_data.begin() + first, wrap_data.begin() + last);
 }
 
-void wrap_info_t::insert_lines(int first, int last) {
+void wrap_info_t::wrap_cache_t::insert_lines(int first, int last) {
   int i;
   for (i = first; i < last; i++) {
     wrap_data.insert(wrap_data.begin() + i, new wrap_points_t());
@@ -49,7 +70,7 @@ void wrap_info_t::insert_lines(int first, int last) {
   }
 }
 
-void wrap_info_t::rewrap_line(int line, int pos, bool local) {
+void wrap_info_t::wrap_cache_t::rewrap_line(int line, int pos, bool local) {
   text_line_t::break_pos_t break_pos;
   size_t i;
 
@@ -80,44 +101,12 @@ void wrap_info_t::rewrap_line(int line, int pos, bool local) {
   size += wrap_data[line]->size();
 }
 
-void wrap_info_t::rewrap_all() {
-  for (size_t i = 0; i < wrap_data.size(); i++) rewrap_line(i, 0, false);
-}
-
-void wrap_info_t::set_wrap_width(int width) {
-  lprintf("Setting wrap width: %d\n", width);
-  if (width == wrap_width) return;
-  wrap_width = width;
-  if (text != nullptr) rewrap_all();
-}
-
-void wrap_info_t::set_tabsize(int _tabsize) {
-  if (_tabsize == tabsize) return;
-  tabsize = _tabsize;
-  if (text != nullptr) rewrap_all();
-}
-
-void wrap_info_t::set_text_buffer(text_buffer_t *_text) {
-  rewrap_connection.disconnect();
-
-  text = _text;
-  if (_text == nullptr) return;
-
-  rewrap_connection = text->connect_rewrap_required(signals::mem_fun(this, &wrap_info_t::rewrap));
-
-  if (wrap_data.size() > text->impl->lines.size())
-    delete_lines(text->impl->lines.size(), wrap_data.size());
-
-  for (size_t i = 0; i < wrap_data.size(); i++) rewrap_line(i, 0, false);
-
-  if (wrap_data.size() < text->impl->lines.size())
-    insert_lines(wrap_data.size(), text->impl->lines.size());
-}
-
-void wrap_info_t::rewrap(rewrap_type_t type, int a, int b) {
+void wrap_info_t::wrap_cache_t::rewrap(rewrap_type_t type, int a, int b) {
+  scoped_timer_t timer(&last_rewrap_time);
+  trace_scope_t trace("wrap_info_t::rewrap");
   switch (type) {
     case rewrap_type_t::REWRAP_ALL:
-      rewrap_all();
+      for (size_t i = 0; i < wrap_data.size(); i++) rewrap_line(i, 0, false);
       break;
     case rewrap_type_t::REWRAP_LINE:
       rewrap_line(a, b, false);
@@ -136,17 +125,85 @@ void wrap_info_t::rewrap(rewrap_type_t type, int a, int b) {
   }
 }
 
+wrap_info_t::wrap_info_t(int width, int _tabsize)
+    : text(nullptr), tabsize(_tabsize), wrap_width(width) {}
+
+wrap_info_t::~wrap_info_t() {}
+
+int wrap_info_t::get_size() const { return cache == nullptr ? 0 : cache->wrap_data.size(); }
+int wrap_info_t::get_text_size() const { return cache == nullptr ? 0 : cache->size; }
+
+size_t wrap_info_t::get_memory_usage() const {
+  if (cache == nullptr) return 0;
+  size_t result = cache->wrap_data.capacity() * sizeof(wrap_points_t *);
+  for (const wrap_points_t *points : cache->wrap_data)
+    result += sizeof(wrap_points_t) + points->capacity() * sizeof(int);
+  return result;
+}
+
+std::chrono::nanoseconds wrap_info_t::get_last_rewrap_time() const {
+  return cache == nullptr ? std::chrono::nanoseconds(0) : cache->last_rewrap_time;
+}
+
+/* Switch to the wrap cache for the current parameters, creating it if no other wrap_info_t
+   uses it yet. */
+void wrap_info_t::update_cache() {
+  if (text == nullptr) {
+    cache.reset();
+    return;
+  }
+  if (cache != nullptr && cache->text == text && cache->wrap_width == wrap_width &&
+      cache->tabsize == tabsize)
+    return;
+
+  cache.reset();
+  for (std::vector<std::weak_ptr<wrap_cache_t>>::iterator iter = wrap_caches.begin();
+       iter != wrap_caches.end();) {
+    std::shared_ptr<wrap_cache_t> candidate = iter->lock();
+    if (candidate == nullptr) {
+      iter = wrap_caches.erase(iter);
+      continue;
+    }
+    if (candidate->text == text && candidate->wrap_width == wrap_width &&
+        candidate->tabsize == tabsize) {
+      cache = candidate;
+      return;
+    }
+    ++iter;
+  }
+  cache = std::make_shared<wrap_cache_t>(text, wrap_width, tabsize);
+  wrap_caches.push_back(cache);
+}
+
+void wrap_info_t::set_wrap_width(int width) {
+  lcprintf(LOG_WIDGETS, LOG_DEBUG, "Setting wrap width: %d\n", width);
+  if (width == wrap_width) return;
+  wrap_width = width;
+  update_cache();
+}
+
+void wrap_info_t::set_tabsize(int _tabsize) {
+  if (_tabsize == tabsize) return;
+  tabsize = _tabsize;
+  update_cache();
+}
+
+void wrap_info_t::set_text_buffer(text_buffer_t *_text) {
+  text = _text;
+  update_cache();
+}
+
 bool wrap_info_t::add_lines(text_coordinate_t &coord, int count) const {
   ASSERT(count > 0);
-  while (coord.line < (int)wrap_data.size() &&
-         (int)wrap_data[coord.line]->size() <= coord.pos + count) {
-    count -= wrap_data[coord.line]->size() - coord.pos;
+  while (coord.line < (int)cache->wrap_data.size() &&
+         (int)cache->wrap_data[coord.line]->size() <= coord.pos + count) {
+    count -= cache->wrap_data[coord.line]->size() - coord.pos;
     coord.line++;
     coord.pos = 0;
   }
-  if (coord.line == (int)wrap_data.size()) {
-    coord.line = wrap_data.size() - 1;
-    coord.pos = wrap_data[coord.line]->size() - 1;
+  if (coord.line == (int)cache->wrap_data.size()) {
+    coord.line = cache->wrap_data.size() - 1;
+    coord.pos = cache->wrap_data[coord.line]->size() - 1;
     return true;
   } else {
     coord.pos += count;
@@ -162,28 +219,29 @@ bool wrap_info_t::sub_lines(text_coordinate_t &coord, int count) const {
   }
   count -= coord.pos;
   coord.pos = 0;
-  while (coord.line > 0 && count >= (int)wrap_data[coord.line - 1]->size()) {
+  while (coord.line > 0 && count >= (int)cache->wrap_data[coord.line - 1]->size()) {
     coord.line--;
-    count -= wrap_data[coord.line]->size();
+    count -= cache->wrap_data[coord.line]->size();
   }
   if (count == 0) return false;
   if (coord.line == 0) return true;
   coord.line--;
-  coord.pos = wrap_data[coord.line]->size() - count;
+  coord.pos = cache->wrap_data[coord.line]->size() - count;
   return false;
 }
 
-int wrap_info_t::get_line_count(int line) const { return (int)wrap_data[line]->size(); }
+int wrap_info_t::get_line_count(int line) const { return (int)cache->wrap_data[line]->size(); }
 
 text_coordinate_t wrap_info_t::get_end() const {
-  text_coordinate_t result((int)wrap_data.size() - 1,
-                           (int)wrap_data[wrap_data.size() - 1]->size() - 1);
+  text_coordinate_t result((int)cache->wrap_data.size() - 1,
+                           (int)cache->wrap_data[cache->wrap_data.size() - 1]->size() - 1);
   return result;
 }
 
 int wrap_info_t::find_line(text_coordinate_t coord) const {
+  const wrap_points_t &points = *cache->wrap_data[coord.line];
   size_t i;
-  for (i = 1; i < wrap_data[coord.line]->size() && coord.pos >= (*wrap_data[coord.line])[i]; i++) {
+  for (i = 1; i < points.size() && coord.pos >= points[i]; i++) {
   }
   return i - 1;
 }
@@ -193,23 +251,23 @@ int wrap_info_t::calculate_screen_pos() const { return calculate_screen_pos(&tex
 int wrap_info_t::calculate_screen_pos(const text_coordinate_t *where) const {
   int sub_line;
   sub_line = find_line(text->cursor);
-  return text->impl->lines[where->line]->calculate_screen_width((*wrap_data[where->line])[sub_line],
-                                                                where->pos, tabsize);
+  return text->impl->lines[where->line]->calculate_screen_width(
+      (*cache->wrap_data[where->line])[sub_line], where->pos, tabsize);
 }
 
 int wrap_info_t::calculate_line_pos(int line, int pos, int sub_line) const {
+  const wrap_points_t &points = *cache->wrap_data[line];
   return text->impl->lines[line]->calculate_line_pos(
-      (*wrap_data[line])[sub_line],
-      sub_line + 1 < (int)wrap_data[line]->size() ? (*wrap_data[line])[sub_line + 1] - 1 : INT_MAX,
+      points[sub_line], sub_line + 1 < (int)points.size() ? points[sub_line + 1] - 1 : INT_MAX,
       pos, tabsize);
 }
 
 void wrap_info_t::paint_line(t3_window_t *win, text_coordinate_t line,
                              text_line_t::paint_info_t *info) const {
-  info->start = (*wrap_data[line.line])[line.pos];
+  info->start = (*cache->wrap_data[line.line])[line.pos];
   info->flags &= ~text_line_t::BREAK;
-  if (line.pos + 1 < (int)wrap_data[line.line]->size()) {
-    info->max = (*wrap_data[line.line])[line.pos + 1];
+  if (line.pos + 1 < (int)cache->wrap_data[line.line]->size()) {
+    info->max = (*cache->wrap_data[line.line])[line.pos + 1];
     info->flags |= text_line_t::BREAK;
   } else {
     info->max = INT_MAX;
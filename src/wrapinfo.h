@@ -14,6 +14,8 @@
 #ifndef T3_WIDGET_WRAPINFO_H
 #define T3_WIDGET_WRAPINFO_H
 
+#include <chrono>
+#include <memory>
 #include <vector>
 
 #include <t3widget/textbuffer.h>
@@ -34,22 +36,29 @@ typedef std::vector<wrap_points_t *> wrap_data_t;
 */
 class T3_WIDGET_LOCAL wrap_info_t {
  private:
-  wrap_data_t wrap_data;
+  /* Wrap points for all lines of a text_buffer_t, for a single wrap width and tab size. These
+     are shared between all wrap_info_t instances with the same parameters for the same
+     text_buffer_t, such that multiple views on a single text only wrap it once. */
+  class wrap_cache_t;
+  /* All wrap caches currently in use. Entries expire when the last wrap_info_t using them
+     switches to different parameters or is destroyed. */
+  static std::vector<std::weak_ptr<wrap_cache_t>> wrap_caches;
+
+  std::shared_ptr<wrap_cache_t> cache;
   text_buffer_t *text;
-  int size, tabsize, wrap_width;
-  signals::connection rewrap_connection;
+  int tabsize, wrap_width;
 
-  void delete_lines(int first, int last);
-  void insert_lines(int first, int last);
-  void rewrap_line(int line, int pos, bool force);
-  void rewrap_all();
-  void rewrap(rewrap_type_t type, int a, int b);
+  void update_cache();
 
  public:
   wrap_info_t(int width, int tabsize = 8);
   ~wrap_info_t();
   int get_size() const;
   int get_text_size() const;
+  /** Get the number of bytes of memory used for the wrap points. */
+  size_t get_memory_usage() const;
+  /** Get the duration of the last update of the wrap points. */
+  std::chrono::nanoseconds get_last_rewrap_time() const;
 
   void set_wrap_width(int width);
   void set_tabsize(int _tabsize);
@@ -26,6 +26,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 #endif
+#ifdef HAS_EPOLL
+#include <cstdint>
+#include <sys/eventfd.h>
+#endif
 
 #include <t3widget/extclipboard.h>
 #include <t3widget/log.h>
@@ -92,7 +96,12 @@ class x11_base_t {
   ~x11_base_t() = default;
 
   bool init() {
+#ifdef HAS_EPOLL
+    /* An eventfd serves as both ends of the wake-up pipe. */
+    if ((wakeup_pipe[0] = wakeup_pipe[1] = eventfd(0, EFD_CLOEXEC)) < 0) return false;
+#else
     if (pipe(wakeup_pipe) < 0) return false;
+#endif
     x11_initialized = true;
     return true;
   }
@@ -103,6 +112,7 @@ class x11_base_t {
   void x11_acknowledge_wakeup(fd_set *fds) {
     /* Clear data from wake-up pipe */
     if (FD_ISSET(wakeup_pipe[0], fds)) {
+      /* For an eventfd, a single read of 8 bytes resets the counter. */
       char buffer[8];
       read(wakeup_pipe[0], buffer, sizeof(buffer));
     }
@@ -114,7 +124,14 @@ class x11_base_t {
     return wakeup_pipe[0] + 1;
   }
 
-  void send_wakeup() { write(wakeup_pipe[1], &wakeup_pipe, 1); }
+  void send_wakeup() {
+#ifdef HAS_EPOLL
+    uint64_t value = 1;
+    write(wakeup_pipe[1], &value, sizeof(value));
+#else
+    write(wakeup_pipe[1], &wakeup_pipe, 1);
+#endif
+  }
 
   x11_atom_t get_atom(int atom) { return atoms[atom]; }
   x11_window_t get_window() { return window; }
@@ -214,7 +231,7 @@ class x11_impl_t : public x11_base_t {
     x11_initialized = true;
     if (!x11_base_t::init()) goto error_exit;
 
-    lprintf("X11 interface initialized\n");
+    lcprintf(LOG_CLIPBOARD, LOG_INFO, "X11 interface initialized\n");
     return true;
 
   error_exit:
@@ -228,7 +245,7 @@ class x11_impl_t : public x11_base_t {
 
   void x11_flush() {
     XFlush(display);
-    write(wakeup_pipe[1], &wakeup_pipe, 1);
+    send_wakeup();
   }
 
   void x11_set_selection_owner(x11_atom_t selection, x11_window_t win, x11_time_t since) {
@@ -382,7 +399,7 @@ class x11_impl_t : public x11_base_t {
     x11_initialized = true;
     connection = local_connection.release();
 
-    lprintf("X11 interface initialized\n");
+    lcprintf(LOG_CLIPBOARD, LOG_INFO, "X11 interface initialized\n");
     return true;
   }
 
@@ -979,7 +996,7 @@ int x11_impl_t::error_handler(Display *_display, XErrorEvent *error) {
   char error_text[1024];
   XGetErrorText(_display, error->error_code, error_text, sizeof(error_text));
 
-  lprintf("X11 error handler: %s\n", error_text);
+  lcprintf(LOG_CLIPBOARD, LOG_ERROR, "X11 error handler: %s\n", error_text);
 #else
   (void)_display;
   (void)error;
@@ -992,7 +1009,7 @@ int x11_impl_t::error_handler(Display *_display, XErrorEvent *error) {
 /** Handle IO errors. */
 int x11_impl_t::io_error_handler(Display *_display) {
   (void)_display;
-  lprintf("X11 IO error\n");
+  lcprintf(LOG_CLIPBOARD, LOG_ERROR, "X11 IO error\n");
   /* Note that this is the only place this variable is ever written, so there
      is no problem in not using a lock here. */
   x11_driver_t::implementation->x11.x11_error = true;
@@ -1001,12 +1018,12 @@ int x11_impl_t::io_error_handler(Display *_display) {
 #endif
 
 static bool init_x11() {
-  lprintf("Starting X11 initialization\n");
+  lcprintf(LOG_CLIPBOARD, LOG_INFO, "Starting X11 initialization\n");
   if (!x11_driver_t::implementation) x11_driver_t::implementation = new x11_driver_t;
   if (!x11_driver_t::implementation->init_x11()) {
     delete x11_driver_t::implementation;
     x11_driver_t::implementation = nullptr;
-    lprintf("X11 initialization failed!\n");
+    lcprintf(LOG_CLIPBOARD, LOG_ERROR, "X11 initialization failed!\n");
     return false;
   }
   return true;
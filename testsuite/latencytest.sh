@@ -0,0 +1,23 @@
+#!/bin/bash
+
+DIR="`dirname \"$0\"`"
+. "$DIR"/_common.sh
+
+
+if [ $# -ne 1 ] ; then
+	fail "Usage: latencytest.sh <dir with test>"
+fi
+
+setup_TEST "$1"
+cd_workdir
+
+rm *
+
+build_test
+
+# Replays each recording without a terminal, and prints one line of JSON per recording with the
+# input-to-screen-update latencies and the number of bytes written to the terminal per send.
+for RECORDING in $TEST/recording* ; do
+	./test -t -l "$RECORDING" || fail "!! Could not replay $RECORDING"
+done
+exit 0
@@ -19,6 +19,9 @@ fi
 
 cd "$DIR" || fail "Could not change to base dir"
 
+# With LATENCY=1, the latency of each test is measured as well, and written to latency.txt.
+[ "$LATENCY" = 1 ] && rm -f latency.txt
+
 LASTLOG_TIME=`find testlog.txt -printf '%TF@%TT' 2>/dev/null`
 if [ $? -eq 0 ] ; then
         mv -f testlog.txt "testlog_$LASTLOG_TIME.txt"
@@ -37,6 +40,9 @@ for i in `find "$TEST" -maxdepth 1 -mindepth 1 -type d | sort` ; do
 	if ! "$DIR"/runtest.sh "$i" ; then
 		let failed++
 		echo "!! $i failed"
+	elif [ "$LATENCY" = 1 ] && ! "$DIR"/latencytest.sh "$i" >> latency.txt ; then
+		let failed++
+		echo "!! $i latency replay failed"
 	fi
 	let total++
 done 2> testlog.txt
@@ -1,15 +1,22 @@
 #include <cstdlib>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <csignal>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
 
 #include "widget.h"
+#include "headless.h"
 
 using namespace t3_widget;
 
 static bool option_test_mode;
+static const char *option_latency_recording;
 static FILE *log_file;
 
 static const char *executable;
@@ -41,6 +48,131 @@ void lprintf(const char *fmt, ...) {
 	}
 }
 
+/* Replaying a recording for latency measurements. Only the send commands of the recording are
+   used, and they are sent as fast as possible, rather than with the recorded delays. */
+struct replay_t {
+	int lines, columns;
+	std::vector<std::string> sends;
+
+	replay_t(void) : lines(24), columns(80) {}
+};
+
+/* Decode a quoted string as written by tdrecord, i.e. with C-style escapes. */
+static bool unescape(const char *str, std::string *result) {
+	if (*str++ != '"')
+		return false;
+	for (; *str != '"'; str++) {
+		if (*str == 0)
+			return false;
+		if (*str != '\\') {
+			*result += *str;
+			continue;
+		}
+		str++;
+		if (*str >= '0' && *str <= '7') {
+			int value = 0;
+			for (int i = 0; i < 3 && *str >= '0' && *str <= '7'; i++, str++)
+				value = value * 8 + *str - '0';
+			str--;
+			*result += (char) value;
+			continue;
+		}
+		switch (*str) {
+			case 'n': *result += '\n'; break;
+			case 'r': *result += '\r'; break;
+			case 't': *result += '\t'; break;
+			case 'e': *result += '\033'; break;
+			case 0: return false;
+			default: *result += *str; break;
+		}
+	}
+	return true;
+}
+
+/* Check whether data only contains cursor position reports. These are answers to the queries
+   done while detecting the terminal capabilities, which the headless terminal answers itself. */
+static bool is_position_report(const std::string &data) {
+	size_t i = 0;
+	while (i < data.size()) {
+		if (data.compare(i, 2, "\033[") != 0)
+			return false;
+		for (i += 2; i < data.size() && ((data[i] >= '0' && data[i] <= '9') || data[i] == ';'); i++) {}
+		if (i == data.size() || data[i] != 'R')
+			return false;
+		i++;
+	}
+	return !data.empty();
+}
+
+static bool read_recording(const char *name, replay_t *replay) {
+	FILE *file;
+	char line[16384];
+
+	if ((file = fopen(name, "r")) == NULL)
+		return false;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		int delay;
+		const char *quote;
+		std::string data;
+
+		if (sscanf(line, "window_size %d %d", &replay->columns, &replay->lines) == 2)
+			continue;
+		/* The delay may be followed by further options, before the data. */
+		if (sscanf(line, "send %d", &delay) != 1)
+			continue;
+		if ((quote = strchr(line, '"')) == NULL || !unescape(quote, &data)) {
+			fprintf(stderr, "Could not parse line: %s", line);
+			fclose(file);
+			return false;
+		}
+		if (!is_position_report(data))
+			replay->sends.push_back(data);
+	}
+	fclose(file);
+	return true;
+}
+
+/* Write each send of the recording, and measure the time until the resulting screen update has
+   been processed by the terminal, and the number of bytes written to the terminal for it. A send
+   usually holds a single key, but may hold several, for example when pasting. */
+static void replay_latency(const char *name, const replay_t *replay) {
+	typedef std::chrono::steady_clock clock;
+	std::vector<double> latencies;
+	unsigned long long output_size;
+	size_t timeouts = 0;
+
+	headless_update();
+	output_size = headless_get_output_size();
+	for (const std::string &data : replay->sends) {
+		clock::time_point start = clock::now();
+		headless_write_input(data.data(), data.size());
+		/* Only handle the keys once the whole send has been decoded, such that the keys of a
+		   send are not attributed to the next one. Sends which are not decoded in time, for
+		   example because they end in an incomplete sequence, are not measured. */
+		bool decoded = headless_wait_input(1000);
+		int exit_code = headless_update();
+		if (decoded)
+			latencies.push_back(std::chrono::duration<double, std::micro>(clock::now() - start).count());
+		else
+			timeouts++;
+		if (exit_code >= 0)
+			break;
+	}
+	output_size = headless_get_output_size() - output_size;
+
+	if (latencies.empty()) {
+		printf("{\"recording\": \"%s\", \"sends\": 0, \"timeouts\": %zu}\n", name, timeouts);
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	printf("{\"recording\": \"%s\", \"sends\": %zu, \"timeouts\": %zu, \"p50_usec\": %.1f, "
+		"\"p99_usec\": %.1f, \"max_usec\": %.1f, \"bytes_per_send\": %.1f}\n", name,
+		latencies.size(), timeouts, latencies[(latencies.size() - 1) * 50 / 100],
+		latencies[(latencies.size() - 1) * 99 / 100], latencies.back(),
+		(double) output_size / (latencies.size() + timeouts));
+}
+
 @CLASS@
 
 class main_t : public main_window_t {
@@ -64,7 +196,7 @@ int main(int argc, char *argv[]) {
 	setrlimit(RLIMIT_AS, &vm_limit);
 
 	int c;
-	while ((c = getopt(argc, argv, "dht")) != -1) {
+	while ((c = getopt(argc, argv, "dhtl:")) != -1) {
 		switch (c) {
 			case 'd':
 				getchar();
@@ -73,10 +205,15 @@ int main(int argc, char *argv[]) {
 				printf("Usage: test [<options>]\n");
 				printf("  -d         Wait for debugger to attach\n");
 				printf("  -t         Enable test mode (disable automatic debugger launch\n");
+				printf("  -l <file>  Replay the recording <file> without a terminal and report the\n"
+					"             latency of each send\n");
 				break;
 			case 't':
 				option_test_mode = true;
 				break;
+			case 'l':
+				option_latency_recording = optarg;
+				break;
 			default:
 				fprintf(stderr, "Unknown option -%c\n", c);
 				exit(EXIT_FAILURE);
@@ -92,8 +229,19 @@ int main(int argc, char *argv[]) {
 	setlocale(LC_ALL, "");
 	log_file = fopen("test.log", "w+");
 
+	replay_t replay;
+	if (option_latency_recording != NULL && !read_recording(option_latency_recording, &replay)) {
+		fprintf(stderr, "Could not read recording %s\n", option_latency_recording);
+		exit(EXIT_FAILURE);
+	}
+
 	complex_error_t result;
 	init_parameters_t *params = init_parameters_t::create();
+	if (option_latency_recording != NULL) {
+		params->headless = true;
+		params->headless_lines = replay.lines;
+		params->headless_columns = replay.columns;
+	}
 	if (!(result = init(params)).get_success()) {
 		fprintf(stderr, "Error: %s\n", result.get_string());
 		fprintf(stderr, "init failed\n");
@@ -108,6 +256,10 @@ int main(int argc, char *argv[]) {
 	atexit(::cleanup);
 	main_window->show();
 	set_key_timeout(100);
+	if (option_latency_recording != NULL) {
+		replay_latency(option_latency_recording, &replay);
+		return 0;
+	}
 	main_loop();
 	return 0;
 }